@@ -5,128 +5,4106 @@
 #include <obs-module.h>
 #include <graphics/graphics.h>
 #include <util/platform.h>
-#include <deque>
+#include <util/profiler.h>
 #include <vector>
 #include <string>
 #include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <algorithm>
 #include <cmath>
 #include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <d3d11.h>
+#include <dxgi1_4.h>
+#else
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifdef LOOPER_ENCODED_RING
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define LOOPER_SSE2
+#endif
+
+OBS_DECLARE_MODULE()
+OBS_MODULE_USE_DEFAULT_LOCALE("obs-pingpong-loop-filter", "en-US")
+
+#define PLUGIN_NAME        "Looper"
+#define PLUGIN_ID          "com.biztactix.obs.looper"
+
+// Profiler scope names (libobs compares these by pointer). Per-frame render
+// cost shows up under these in OBS's profiler output at shutdown.
+static const char *capture_profile_name = "looper_capture";
+static const char *playback_profile_name = "looper_playback";
+
+// ----------------------------- Utilities -----------------------------
+
+static inline double fps_from_ovi(const obs_video_info &ovi)
+{
+	return ovi.fps_den ? (double)ovi.fps_num / (double)ovi.fps_den : 60.0;
+}
+
+// Clamp utility
+template<typename T> static inline T clampv(T v, T lo, T hi)
+{
+	return v < lo ? lo : (v > hi ? hi : v);
+}
+
+// How buffered frames are kept on the GPU
+enum frame_storage {
+	STORAGE_RGBA = 0, // Full quality, 4 bytes/px
+	STORAGE_NV12 = 1, // Luma + half-resolution interleaved chroma in one R8 texture, 1.5 bytes/px
+	STORAGE_BC1 = 2,  // BC1-style 4x4 blocks, one RGBA16 texel per block, 0.5 bytes/px
+};
+
+static inline gs_color_format storage_color_format(int storage)
+{
+	switch (storage) {
+	case STORAGE_NV12:
+		return GS_R8;
+	case STORAGE_BC1:
+		return GS_RGBA16;
+	default:
+		return GS_RGBA;
+	}
+}
+
+static inline size_t storage_texel_bytes(int storage)
+{
+	switch (storage) {
+	case STORAGE_NV12:
+		return 1;
+	case STORAGE_BC1:
+		return 8;
+	default:
+		return 4;
+	}
+}
+
+// looper.effect technique that converts into (pack) or out of the storage layout
+static inline const char *storage_technique(int storage, bool pack)
+{
+	if (storage == STORAGE_BC1)
+		return pack ? "PackBC1" : "UnpackBC1";
+	return pack ? "PackNV12" : "UnpackNV12";
+}
+
+// looper.effect technique that plays back two frames of the storage layout blended
+static inline const char *blend_technique(int storage)
+{
+	if (storage == STORAGE_BC1)
+		return "BlendBC1";
+	return storage == STORAGE_NV12 ? "BlendNV12" : "BlendRGBA";
+}
+
+// Size of the texture one frame occupies in the given storage mode
+static inline void storage_texture_size(int storage, uint32_t w, uint32_t h, uint32_t *cx, uint32_t *cy)
+{
+	if (storage == STORAGE_NV12) {
+		// Chroma pairs need an even width; chroma rows follow the luma rows
+		*cx = (w + 1) & ~1u;
+		*cy = h + (h + 1) / 2;
+	} else if (storage == STORAGE_BC1) {
+		// One texel per 4x4 block, partial edge blocks included
+		*cx = (w + 3) / 4;
+		*cy = (h + 3) / 4;
+	} else {
+		*cx = w;
+		*cy = h;
+	}
+}
+
+static inline size_t storage_bytes_per_frame(int storage, uint32_t w, uint32_t h)
+{
+	uint32_t cx, cy;
+	storage_texture_size(storage, w, h, &cx, &cy);
+	return (size_t)cx * cy * storage_texel_bytes(storage);
+}
+
+// Bytes a driver allocates for a 2D texture: rows padded to a 256-byte pitch and
+// the whole allocation rounded up to 64KB pages, as D3D11 and the common GL
+// drivers lay out render targets
+static inline size_t texture_alloc_bytes(gs_color_format format, uint32_t w, uint32_t h)
+{
+	size_t pitch = ((size_t)w * gs_get_format_bpp(format) / 8 + 255) & ~(size_t)255;
+	return (pitch * h + 65535) & ~(size_t)65535;
+}
+
+// Allocated size of one frame's storage texture
+static inline size_t storage_alloc_bytes(int storage, uint32_t w, uint32_t h)
+{
+	uint32_t cx, cy;
+	storage_texture_size(storage, w, h, &cx, &cy);
+	return texture_alloc_bytes(storage_color_format(storage), cx, cy);
+}
+
+// Fixed-capacity FIFO of storage slots. Index 0 is the oldest entry; slots past
+// 'count' are free and keep their allocation so they can be reused in place.
+template<typename T> struct frame_ring {
+	std::vector<T> slots;
+	size_t head = 0;
+	size_t count = 0;
+
+	size_t capacity() const { return slots.size(); }
+	bool full() const { return count == slots.size(); }
+	T &at(size_t i) { return slots[(head + i) % slots.size()]; }
+	T &next() { return slots[(head + count) % slots.size()]; } // First free slot, only valid if !full()
+	void push() { count++; }
+	void pop()
+	{
+		head = (head + 1) % slots.size();
+		count--;
+	}
+	void clear()
+	{
+		head = 0;
+		count = 0;
+	}
+
+	// Resize to 'new_capacity' slots keeping the newest entries in order. Free
+	// slots are reused before new ones are made with create(); slots that no
+	// longer fit go to release(). Returns the number of entries dropped.
+	template<typename Create, typename Release> size_t resize(size_t new_capacity, Create create, Release release)
+	{
+		if (new_capacity == slots.size())
+			return 0;
+
+		size_t keep = count < new_capacity ? count : new_capacity;
+		size_t dropped = count - keep;
+
+		std::vector<T> resized;
+		resized.reserve(new_capacity);
+		for (size_t i = dropped; i < count; ++i)
+			resized.push_back(std::move(at(i)));
+
+		// Free slots first, then the dropped entries
+		size_t old_size = slots.size();
+		for (size_t i = 0; i < old_size - keep; ++i) {
+			T &slot = slots[(head + count + i) % old_size];
+			if (resized.size() < new_capacity)
+				resized.push_back(std::move(slot));
+			else
+				release(slot);
+		}
+
+		while (resized.size() < new_capacity)
+			resized.push_back(create());
+
+		slots.swap(resized);
+		head = 0;
+		count = keep;
+		return dropped;
+	}
+
+	// Keep only the entries for which keep(i) is true, in order. Dropped entries
+	// go to release() and stay behind as free slots. Returns the number dropped.
+	template<typename Keep, typename Release> size_t thin(Keep keep, Release release)
+	{
+		size_t kept = 0;
+		for (size_t i = 0; i < count; ++i) {
+			if (!keep(i)) {
+				release(at(i));
+				continue;
+			}
+			if (kept != i)
+				std::swap(at(kept), at(i));
+			kept++;
+		}
+		size_t dropped = count - kept;
+		count = kept;
+		return dropped;
+	}
+};
+
+// Luma thumbnail measured for every capture. The frame's signature and motion
+// score are derived from it, and seamless loop points are matched on it.
+#define LOOPER_THUMB_W     32
+#define LOOPER_THUMB_H     18
+#define LOOPER_THUMB_BYTES (LOOPER_THUMB_W * LOOPER_THUMB_H)
+
+// Shortest forward loop seamless loop points ever cut the buffer down to
+#define LOOPER_LOOP_MIN_NS 3000000000ull
+
+// Sum of absolute differences between two thumbnails
+static uint32_t thumb_distance(const uint8_t *a, const uint8_t *b)
+{
+	size_t i = 0;
+	uint32_t sum = 0;
+#ifdef LOOPER_SSE2
+	// psadbw sums 16 byte differences into two 64-bit lanes per step
+	__m128i acc = _mm_setzero_si128();
+	for (; i + 16 <= LOOPER_THUMB_BYTES; i += 16) {
+		__m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+		__m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+		acc = _mm_add_epi64(acc, _mm_sad_epu8(va, vb));
+	}
+	sum = (uint32_t)_mm_cvtsi128_si32(acc) + (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(acc, 8));
+#endif
+	for (; i < LOOPER_THUMB_BYTES; ++i)
+		sum += (uint32_t)std::abs((int)a[i] - (int)b[i]);
+	return sum;
+}
+
+// Per-frame metadata as a struct of arrays. Rows follow the same ring layout
+// as the frame tiers (row 0 is the oldest buffered frame), and each field is
+// its own contiguous array, so a pass over one field only touches that field.
+// spans() splits the buffered rows into at most two contiguous runs for such
+// passes.
+struct frame_meta_table {
+	std::vector<uint64_t> timestamp;    // Capture time in ns
+	std::vector<uint64_t> duration;     // Time until the next capture in ns, nominal for the newest frame
+	std::vector<uint64_t> start;        // Position on the content clock in ns: all earlier durations summed
+	std::vector<uint64_t> signature;    // 8x8 average hash of the frame's luma
+	std::vector<float> motion;          // Mean luma change from the previous capture, 0–1
+	std::vector<uint8_t> valid;         // Signature and motion have been measured
+	std::vector<uint64_t> serial;       // Capture number, matches asynchronous measurements to rows
+	std::vector<uint8_t> thumb;         // LOOPER_THUMB_BYTES per row: the measured thumbnail
+	std::vector<uint32_t> match_dist;   // Thumbnail distance to the closest later frame, see loop points
+	std::vector<uint64_t> match_serial; // Capture number of that frame, UINT64_MAX for none yet
+	size_t head = 0;
+	size_t count = 0;
+
+	size_t capacity() const { return timestamp.size(); }
+	bool full() const { return count == capacity(); }
+	size_t slot(size_t i) const { return (head + i) % capacity(); }
+
+	// Buffered rows are slots [head, head + *first) followed by [0, *second)
+	void spans(size_t *first, size_t *second) const
+	{
+		size_t to_end = capacity() - head;
+		*first = count < to_end ? count : to_end;
+		*second = count - *first;
+	}
+
+	void copy_row(size_t dst, size_t src)
+	{
+		timestamp[dst] = timestamp[src];
+		duration[dst] = duration[src];
+		start[dst] = start[src];
+		signature[dst] = signature[src];
+		motion[dst] = motion[src];
+		valid[dst] = valid[src];
+		serial[dst] = serial[src];
+		memcpy(&thumb[dst * LOOPER_THUMB_BYTES], &thumb[src * LOOPER_THUMB_BYTES], LOOPER_THUMB_BYTES);
+		match_dist[dst] = match_dist[src];
+		match_serial[dst] = match_serial[src];
+	}
+
+	// Append a row for a new capture and return its slot. Only valid if !full().
+	size_t push(uint64_t time, uint64_t nominal_duration, uint64_t capture_serial)
+	{
+		size_t prev = count > 0 ? slot(count - 1) : 0;
+		uint64_t position = count > 0 ? start[prev] + duration[prev] : 0;
+		size_t s = slot(count++);
+		timestamp[s] = time;
+		duration[s] = nominal_duration;
+		start[s] = position;
+		signature[s] = 0;
+		motion[s] = 0.0f;
+		valid[s] = 0;
+		serial[s] = capture_serial;
+		match_dist[s] = UINT32_MAX;
+		match_serial[s] = UINT64_MAX;
+		return s;
+	}
+	void pop()
+	{
+		head = (head + 1) % capacity();
+		count--;
+	}
+	// Remove row 'i', moving the older rows up one place. The row before it
+	// takes over its duration, like thin() does.
+	void erase(size_t i)
+	{
+		if (i > 0)
+			duration[slot(i - 1)] += duration[slot(i)];
+		for (; i > 0; --i)
+			copy_row(slot(i), slot(i - 1));
+		pop();
+	}
+	// Keep only the rows for which keep(i) is true, in order. A kept row takes
+	// over the durations of the dropped rows after it, so the buffer's length
+	// is unchanged.
+	template<typename Keep> void thin(Keep keep)
+	{
+		size_t kept = 0;
+		for (size_t i = 0; i < count; ++i) {
+			if (!keep(i)) {
+				if (kept > 0)
+					duration[slot(kept - 1)] += duration[slot(i)];
+				continue;
+			}
+			if (kept != i)
+				copy_row(slot(kept), slot(i));
+			kept++;
+		}
+		count = kept;
+	}
+	void clear()
+	{
+		head = 0;
+		count = 0;
+	}
+
+	// Content time from row 0 to row 'i', and over all rows, in ns
+	uint64_t offset(size_t i) const { return start[slot(i)] - start[head]; }
+	uint64_t length() const { return count > 0 ? offset(count - 1) + duration[slot(count - 1)] : 0; }
+
+	// Row on screen at content time 'position' ns after row 0
+	size_t row_at(uint64_t position) const
+	{
+		size_t lo = 0, hi = count;
+		while (hi - lo > 1) {
+			size_t mid = lo + (hi - lo) / 2;
+			if (offset(mid) <= position)
+				lo = mid;
+			else
+				hi = mid;
+		}
+		return lo;
+	}
+
+	// Row of capture 'serial', SIZE_MAX if it has left the table. Serials grow
+	// with the row index, though thinning leaves gaps.
+	size_t row_of_serial(uint64_t capture_serial) const
+	{
+		size_t lo = 0, hi = count;
+		while (lo < hi) {
+			size_t mid = lo + (hi - lo) / 2;
+			if (serial[slot(mid)] < capture_serial)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		return lo < count && serial[slot(lo)] == capture_serial ? lo : SIZE_MAX;
+	}
+
+	// Resize keeping the newest rows in order
+	void resize(size_t new_capacity)
+	{
+		if (new_capacity == capacity())
+			return;
+
+		frame_meta_table resized;
+		resized.timestamp.resize(new_capacity);
+		resized.duration.resize(new_capacity);
+		resized.start.resize(new_capacity);
+		resized.signature.resize(new_capacity);
+		resized.motion.resize(new_capacity);
+		resized.valid.resize(new_capacity);
+		resized.serial.resize(new_capacity);
+		resized.thumb.resize(new_capacity * LOOPER_THUMB_BYTES);
+		resized.match_dist.resize(new_capacity);
+		resized.match_serial.resize(new_capacity);
+
+		size_t keep = count < new_capacity ? count : new_capacity;
+		for (size_t i = count - keep; i < count; ++i) {
+			size_t src = slot(i);
+			size_t dst = resized.count++;
+			resized.timestamp[dst] = timestamp[src];
+			resized.duration[dst] = duration[src];
+			resized.start[dst] = start[src];
+			resized.signature[dst] = signature[src];
+			resized.motion[dst] = motion[src];
+			resized.valid[dst] = valid[src];
+			resized.serial[dst] = serial[src];
+			memcpy(&resized.thumb[dst * LOOPER_THUMB_BYTES], &thumb[src * LOOPER_THUMB_BYTES],
+			       LOOPER_THUMB_BYTES);
+			resized.match_dist[dst] = match_dist[src];
+			resized.match_serial[dst] = match_serial[src];
+		}
+		*this = std::move(resized);
+	}
+};
+
+// Captures a frame spends in a staging surface before it is mapped into host
+// memory, so readback never stalls the pipeline
+#define LOOPER_READBACK_DEPTH 3
+
+// A capture's luma thumbnail on its way back from the GPU. Probes are read
+// LOOPER_READBACK_DEPTH captures later, like frames spilled to host memory.
+struct signature_probe {
+	gs_texrender_t *target = nullptr;
+	gs_stagesurf_t *stage = nullptr;
+	uint64_t serial = 0; // Capture number of the frame measured
+};
+
+// Motion-compensated playback keeps the quarter-resolution luma of the last
+// few frames it drew and the block motion between the last few frame pairs,
+// keyed by capture number, so each pair is only measured once
+#define LOOPER_FLOW_CACHE 4
+
+struct flow_luma {
+	gs_texrender_t *target = nullptr;
+	uint64_t serial = UINT64_MAX; // Capture number of the frame
+	uint64_t used = 0;            // flow_clock when last drawn with
+};
+
+struct flow_field {
+	gs_texrender_t *target = nullptr;
+	uint64_t from = UINT64_MAX; // Capture numbers of the pair
+	uint64_t to = UINT64_MAX;
+	uint64_t used = 0;
+};
+
+// GPU time of one render pass, from timer queries read back
+// LOOPER_GPU_TIMER_DEPTH frames later so the render never waits on them.
+// The average is logged every LOOPER_GPU_TIMER_LOG samples.
+#define LOOPER_GPU_TIMER_DEPTH 4
+#define LOOPER_GPU_TIMER_LOG   600
+
+struct gpu_pass_timer {
+	const char *name = "";
+	gs_timer_range_t *ranges[LOOPER_GPU_TIMER_DEPTH] = {};
+	gs_timer_t *timers[LOOPER_GPU_TIMER_DEPTH] = {};
+	bool pending[LOOPER_GPU_TIMER_DEPTH] = {};
+	size_t next = 0;     // Query slot of the next pass
+	bool active = false; // A pass is being timed
+	uint64_t total_ns = 0;
+	uint64_t samples = 0;
+};
+
+// Where frames go once the VRAM budget is used up
+enum overflow_tier {
+	OVERFLOW_NONE = 0,   // Buffer is limited to what fits in VRAM
+	OVERFLOW_SYSTEM_RAM, // Older frames are read back and kept in system RAM
+	OVERFLOW_DISK,       // Older frames are read back into a memory-mapped cache file
+	OVERFLOW_COMPRESSED, // Older frames are read back and losslessly compressed in system RAM
+	OVERFLOW_ENCODED,    // Older frames are read back and H.264 encoded in system RAM
+};
+
+// Tiers whose frames are encoded by the codec workers
+static inline bool overflow_is_coded(int overflow)
+{
+	return overflow == OVERFLOW_COMPRESSED || overflow == OVERFLOW_ENCODED;
+}
+
+// Longest buffer each overflow tier allows. Only the disk and coded tiers can
+// hold minutes of frames without pinning them all in memory.
+static inline int max_buffer_seconds(int overflow)
+{
+	return overflow == OVERFLOW_DISK || overflow_is_coded(overflow) ? 600 : 60;
+}
+
+// Host-tier frames the playback cursor asks the OS to page in ahead of time
+#define LOOPER_PREFETCH_FRAMES 8
+
+// Which frames go when a smaller memory limit shrinks a full buffer
+enum eviction_policy {
+	EVICT_OLDEST = 0,   // Drop the oldest frames: same frame rate, shorter loop
+	EVICT_DECIMATE = 1, // Drop every k-th frame: same loop length, lower frame rate
+};
+
+// What playback shows between two buffered frames
+enum playback_interpolation {
+	INTERP_NONE = 0,  // Hold the earlier frame
+	INTERP_BLEND = 1, // Cross-fade into the next frame
+	INTERP_FLOW = 2,  // Cross-fade along block motion vectors between the frames
+};
+
+// Frame data shared between the filter and the codec workers
+typedef std::shared_ptr<std::vector<uint8_t>> frame_buffer;
+
+// A frame in the host tier: its own buffer in system RAM, a fixed slot in the
+// disk cache file, or a compressed buffer
+struct host_frame {
+	std::vector<uint8_t> ram;
+	uint64_t offset = 0;
+
+	// Coded tiers: the frame stays raw until a worker has encoded it
+	uint64_t seq = 0; // Matches codec results to frames
+	frame_buffer raw;
+	frame_buffer packed;
+	bool keyframe = false; // Encoded tier: decoding can start at this frame
+};
+
+// ----------------------------- Disk Cache -----------------------------
+
+// Preallocated temporary file mapped into memory. The page cache keeps recently
+// written and prefetched frames resident and writes the rest out to disk, so
+// the RAM used stays bounded however long the buffer is.
+struct mapped_file {
+	uint8_t *data = nullptr;
+	uint64_t size = 0;
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+#else
+	int fd = -1;
+#endif
+};
+
+static void mapped_file_close(mapped_file *mf)
+{
+#ifdef _WIN32
+	if (mf->data)
+		UnmapViewOfFile(mf->data);
+	if (mf->mapping)
+		CloseHandle(mf->mapping);
+	if (mf->file != INVALID_HANDLE_VALUE)
+		CloseHandle(mf->file); // Deleted on close
+	mf->file = INVALID_HANDLE_VALUE;
+	mf->mapping = nullptr;
+#else
+	if (mf->data)
+		munmap(mf->data, mf->size);
+	if (mf->fd >= 0)
+		close(mf->fd);
+	mf->fd = -1;
+#endif
+	mf->data = nullptr;
+	mf->size = 0;
+}
+
+// Create 'path' with 'size' bytes reserved and map it. The file is unlinked
+// straight away (deleted on close on Windows) so nothing is left behind, even
+// if OBS does not shut down cleanly.
+static bool mapped_file_open(mapped_file *mf, const char *path, uint64_t size)
+{
+	mapped_file_close(mf);
+	if (size == 0)
+		return false;
+
+#ifdef _WIN32
+	mf->file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+			       FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+	if (mf->file == INVALID_HANDLE_VALUE)
+		return false;
+
+	// Creating the mapping extends the file to its full size
+	mf->mapping =
+		CreateFileMappingA(mf->file, nullptr, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size, nullptr);
+	if (mf->mapping)
+		mf->data = (uint8_t *)MapViewOfFile(mf->mapping, FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T)size);
+#else
+	mf->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (mf->fd < 0)
+		return false;
+	unlink(path);
+
+	// Reserve the blocks up front where the filesystem supports it, so a full
+	// disk fails here rather than as a fault while recording
+	bool reserved = false;
+#ifdef __linux__
+	reserved = fallocate(mf->fd, 0, 0, (off_t)size) == 0;
+#endif
+	if (!reserved && ftruncate(mf->fd, (off_t)size) != 0) {
+		mapped_file_close(mf);
+		return false;
+	}
+
+	void *mem = mmap(nullptr, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, mf->fd, 0);
+	if (mem != MAP_FAILED)
+		mf->data = (uint8_t *)mem;
+#endif
+
+	if (!mf->data) {
+		mapped_file_close(mf);
+		return false;
+	}
+	mf->size = size;
+	return true;
+}
+
+// Ask the OS to start reading a range in, so playback doesn't fault on it
+static void mapped_file_prefetch(mapped_file *mf, uint64_t offset, uint64_t len)
+{
+	if (!mf->data || offset >= mf->size)
+		return;
+	if (len > mf->size - offset)
+		len = mf->size - offset;
+
+#ifdef _WIN32
+	WIN32_MEMORY_RANGE_ENTRY range = {mf->data + offset, (SIZE_T)len};
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+	// madvise() wants a page-aligned start
+	uint64_t page = (uint64_t)sysconf(_SC_PAGESIZE);
+	uint64_t start = offset - offset % page;
+	madvise(mf->data + start, (size_t)(offset + len - start), MADV_WILLNEED);
+#endif
+}
+
+// ----------------------------- Frame Codec -----------------------------
+
+// Lossless QOI-style codec for host-tier frames. Frame data is coded as 4-byte
+// units whatever the storage mode, so packed layouts compress too; a trailing
+// partial unit is stored as is. Screen content is mostly runs and small
+// deltas, which this handles well.
+
+#define QOI_OP_INDEX 0x00
+#define QOI_OP_DIFF 0x40
+#define QOI_OP_LUMA 0x80
+#define QOI_OP_RUN 0xc0
+#define QOI_OP_RGB 0xfe
+#define QOI_OP_RGBA 0xff
+#define QOI_START_PIXEL 0xff000000u
+
+static inline uint32_t qoi_hash(uint32_t px)
+{
+	return ((px & 0xff) * 3 + ((px >> 8) & 0xff) * 5 + ((px >> 16) & 0xff) * 7 + (px >> 24) * 11) % 64;
+}
+
+// Worst case is one 5-byte op per unit
+static inline size_t qoi_max_size(size_t len)
+{
+	return (len / 4) * 5 + len % 4;
+}
+
+// Number of units from 'src' on that equal 'px', up to 'max'
+static size_t qoi_run_length(const uint8_t *src, size_t max, uint32_t px)
+{
+	size_t n = 0;
+#ifdef LOOPER_SSE2
+	// Four units per compare on long runs of flat colour
+	__m128i v = _mm_set1_epi32((int)px);
+	while (n + 4 <= max) {
+		__m128i q = _mm_loadu_si128((const __m128i *)(src + n * 4));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(q, v)) != 0xffff)
+			break;
+		n += 4;
+	}
+#endif
+	for (; n < max; ++n) {
+		uint32_t cur;
+		memcpy(&cur, src + n * 4, 4);
+		if (cur != px)
+			break;
+	}
+	return n;
+}
+
+// Encode 'len' bytes into 'dst', which must hold qoi_max_size(len). Returns the encoded size.
+static size_t qoi_encode(const uint8_t *src, size_t len, uint8_t *dst)
+{
+	uint32_t index[64] = {0};
+	uint32_t prev = QOI_START_PIXEL;
+	size_t units = len / 4;
+	uint8_t *out = dst;
+
+	for (size_t i = 0; i < units;) {
+		uint32_t px;
+		memcpy(&px, src + i * 4, 4);
+
+		if (px == prev) {
+			size_t run = qoi_run_length(src + i * 4, units - i, px);
+			i += run;
+			while (run > 0) {
+				size_t n = run < 62 ? run : 62;
+				*out++ = (uint8_t)(QOI_OP_RUN | (n - 1));
+				run -= n;
+			}
+			continue;
+		}
+
+		uint32_t h = qoi_hash(px);
+		if (index[h] == px) {
+			*out++ = (uint8_t)(QOI_OP_INDEX | h);
+		} else {
+			index[h] = px;
+			if ((px >> 24) == (prev >> 24)) {
+				int dr = (int8_t)((px & 0xff) - (prev & 0xff));
+				int dg = (int8_t)(((px >> 8) & 0xff) - ((prev >> 8) & 0xff));
+				int db = (int8_t)(((px >> 16) & 0xff) - ((prev >> 16) & 0xff));
+				int dr_dg = dr - dg;
+				int db_dg = db - dg;
+
+				if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+					*out++ = (uint8_t)(QOI_OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+				} else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 &&
+					   db_dg <= 7) {
+					*out++ = (uint8_t)(QOI_OP_LUMA | (dg + 32));
+					*out++ = (uint8_t)((dr_dg + 8) << 4 | (db_dg + 8));
+				} else {
+					*out++ = QOI_OP_RGB;
+					memcpy(out, &px, 3);
+					out += 3;
+				}
+			} else {
+				*out++ = QOI_OP_RGBA;
+				memcpy(out, &px, 4);
+				out += 4;
+			}
+		}
+		prev = px;
+		i++;
+	}
+
+	memcpy(out, src + units * 4, len % 4);
+	out += len % 4;
+	return (size_t)(out - dst);
+}
+
+// Decode into exactly 'len' bytes. Returns false on malformed input.
+static bool qoi_decode(const uint8_t *src, size_t src_len, uint8_t *dst, size_t len)
+{
+	uint32_t index[64] = {0};
+	uint32_t px = QOI_START_PIXEL;
+	size_t units = len / 4;
+	size_t tail = len % 4;
+	if (src_len < tail)
+		return false;
+
+	const uint8_t *in = src;
+	const uint8_t *end = src + src_len - tail;
+	for (size_t i = 0; i < units;) {
+		if (in >= end)
+			return false;
+		uint8_t op = *in++;
+
+		if (op == QOI_OP_RGB || op == QOI_OP_RGBA) {
+			size_t n = op == QOI_OP_RGB ? 3 : 4;
+			if ((size_t)(end - in) < n)
+				return false;
+			memcpy(&px, in, n);
+			in += n;
+		} else if ((op & 0xc0) == QOI_OP_INDEX) {
+			px = index[op];
+		} else if ((op & 0xc0) == QOI_OP_DIFF) {
+			uint32_t r = (px + ((op >> 4) & 3) - 2) & 0xff;
+			uint32_t g = ((px >> 8) + ((op >> 2) & 3) - 2) & 0xff;
+			uint32_t b = ((px >> 16) + (op & 3) - 2) & 0xff;
+			px = (px & 0xff000000u) | b << 16 | g << 8 | r;
+		} else if ((op & 0xc0) == QOI_OP_LUMA) {
+			if (in >= end)
+				return false;
+			int dg = (op & 0x3f) - 32;
+			int dr = dg + (*in >> 4) - 8;
+			int db = dg + (*in & 0x0f) - 8;
+			in++;
+			uint32_t r = (px + dr) & 0xff;
+			uint32_t g = ((px >> 8) + dg) & 0xff;
+			uint32_t b = ((px >> 16) + db) & 0xff;
+			px = (px & 0xff000000u) | b << 16 | g << 8 | r;
+		} else {
+			size_t run = (size_t)(op & 0x3f) + 1;
+			if (run > units - i)
+				return false;
+			for (size_t k = 0; k < run; ++k)
+				memcpy(dst + (i + k) * 4, &px, 4);
+			i += run;
+			continue;
+		}
+
+		index[qoi_hash(px)] = px;
+		memcpy(dst + i * 4, &px, 4);
+		i++;
+	}
+
+	if (in != end)
+		return false;
+	memcpy(dst + units * 4, end, tail);
+	return true;
+}
+
+// Host-tier frames decoded ahead of the playback cursor
+#define LOOPER_DECODE_AHEAD 4
+
+// Encoded tier keyframe interval. Decoding any frame means decoding its whole
+// group of pictures (GOP), so this also sets the reverse playback cache size.
+#define LOOPER_GOP_FRAMES 30
+
+struct codec_job {
+	bool decode = false;
+	uint64_t seq = 0;  // host_frame::seq the job belongs to, the first one for a GOP
+	frame_buffer in;   // Raw frame to encode, or encoded frame to decode
+	frame_buffer out;  // Decode target to reuse, may be empty
+	size_t raw_bytes = 0;
+
+	// Encoded tier
+	uint32_t width = 0;                // Luma size of the NV12 storage layout
+	uint32_t height = 0;
+	std::vector<frame_buffer> packets; // GOP to decode, keyframe first
+	std::vector<frame_buffer> outs;    // Decode targets to reuse, may be empty
+};
+
+struct codec_result {
+	uint64_t seq = 0;
+	frame_buffer raw;    // Input buffer, returned for reuse
+	frame_buffer packed; // Encoded frame, empty if encoding failed
+	bool keyframe = false;
+};
+
+struct decoded_frame {
+	uint64_t seq = UINT64_MAX;
+	bool ready = false;
+	frame_buffer pixels;
+};
+
+struct codec_stats {
+	uint64_t encoded = 0;
+	uint64_t decoded = 0;
+	uint64_t encode_ns = 0;
+	uint64_t decode_ns = 0;
+	uint64_t raw_bytes = 0;
+	uint64_t packed_bytes = 0;
+};
+
+// Worker threads that compress frames as they reach the host tier and
+// decompress them ahead of playback. Everything below is guarded by 'mtx',
+// which is always taken after frames_mtx.
+struct frame_codec {
+	int kind = OVERFLOW_NONE; // overflow_tier the workers code for
+	std::vector<std::thread> workers;
+	std::mutex mtx;
+	std::condition_variable cv;
+	std::deque<codec_job> jobs;
+	std::vector<codec_result> done;    // Finished encodes, picked up by collect_encoded_locked()
+	std::vector<decoded_frame> cache; // Frames decoded ahead of (and, for GOPs, behind) the cursor
+	codec_stats stats;
+	bool stop = false;
+};
+
+// Hand a decoded frame to the cache entry reserved for it. The entry may have
+// been given to another frame meanwhile. Called with the codec mutex held.
+static void codec_store_decoded(frame_codec *codec, uint64_t seq, frame_buffer &pixels, bool ok)
+{
+	for (auto &entry : codec->cache) {
+		if (entry.seq == seq && !entry.ready) {
+			if (ok) {
+				entry.pixels = std::move(pixels);
+				entry.ready = true;
+			} else {
+				entry.seq = UINT64_MAX;
+			}
+			return;
+		}
+	}
+}
+
+#ifdef LOOPER_ENCODED_RING
+// An encoder only hands its packets to an output, so the encoded tier runs an
+// output of its own that keeps them for the codec worker
+#define LOOPER_H264_OUTPUT_ID "looper_h264_ring"
+
+// Longest the worker waits for a frame's packet before treating it as failed
+#define LOOPER_H264_PACKET_TIMEOUT_MS 1000
+
+struct h264_packet {
+	frame_buffer data;
+	bool keyframe = false;
+};
+
+struct h264_sink {
+	obs_output_t *output = nullptr;
+	std::mutex mtx;
+	std::condition_variable cv;
+	std::deque<h264_packet> packets;
+};
+
+static const char *h264_sink_get_name(void *)
+{
+	return "Looper H.264 Ring";
+}
+
+static void *h264_sink_create(obs_data_t *, obs_output_t *output)
+{
+	auto *sink = new h264_sink();
+	sink->output = output;
+	return sink;
+}
+
+static void h264_sink_destroy(void *data)
+{
+	delete static_cast<h264_sink *>(data);
+}
+
+static bool h264_sink_start(void *data)
+{
+	auto *sink = static_cast<h264_sink *>(data);
+	if (!obs_output_can_begin_data_capture(sink->output, 0) || !obs_output_initialize_encoders(sink->output, 0))
+		return false;
+	return obs_output_begin_data_capture(sink->output, 0);
+}
+
+static void h264_sink_stop(void *data, uint64_t)
+{
+	obs_output_end_data_capture(static_cast<h264_sink *>(data)->output);
+}
+
+// Called on the encoded tier's video output thread
+static void h264_sink_packet(void *data, encoder_packet *packet)
+{
+	auto *sink = static_cast<h264_sink *>(data);
+	if (!packet || packet->type != OBS_ENCODER_VIDEO)
+		return;
+
+	h264_packet copy;
+	copy.data = std::make_shared<std::vector<uint8_t>>(packet->data, packet->data + packet->size);
+	copy.keyframe = packet->keyframe;
+	{
+		std::lock_guard<std::mutex> lk(sink->mtx);
+		sink->packets.push_back(std::move(copy));
+	}
+	sink->cv.notify_one();
+}
+
+// H.264 encoder and decoder of the encoded tier, owned by its single worker
+// thread. Frames come in and go out in the NV12 storage layout: 'height' luma
+// rows followed by (height + 1) / 2 rows of interleaved U/V, 'width' bytes each.
+// Encoding goes through OBS's x264 encoder, fed from a video output of its own;
+// decoding uses the libavcodec that libobs itself is built on.
+struct h264_codec {
+	video_t *video = nullptr;
+	obs_encoder_t *encoder = nullptr;
+	obs_output_t *output = nullptr;
+	uint64_t frames = 0; // Frames given to the video output, for their timestamps
+
+	AVCodecContext *dec = nullptr;
+	AVFrame *frame = nullptr;
+	AVPacket *packet = nullptr;
+	uint32_t width = 0;
+	uint32_t height = 0;
+};
+
+static void h264_close(h264_codec *h)
+{
+	// Stopping the output disconnects the encoder before its video output closes
+	if (h->output) {
+		obs_output_stop(h->output);
+		obs_output_release(h->output);
+		h->output = nullptr;
+	}
+	obs_encoder_release(h->encoder);
+	h->encoder = nullptr;
+	if (h->video) {
+		video_output_close(h->video);
+		h->video = nullptr;
+	}
+	h->frames = 0;
+
+	avcodec_free_context(&h->dec);
+	av_frame_free(&h->frame);
+	av_packet_free(&h->packet);
+	h->width = 0;
+	h->height = 0;
+}
+
+static bool h264_open(h264_codec *h, uint32_t width, uint32_t height)
+{
+	if (h->output && h->width == width && h->height == height)
+		return true;
+	h264_close(h);
+
+	const AVCodec *decoder = avcodec_find_decoder(AV_CODEC_ID_H264);
+	if (!decoder || !obs_get_encoder_codec("obs_x264")) {
+		blog(LOG_WARNING, "[" PLUGIN_ID "] No H.264 %s available", decoder ? "encoder (obs-x264)" : "decoder");
+		return false;
+	}
+
+	h->dec = avcodec_alloc_context3(decoder);
+	h->frame = av_frame_alloc();
+	h->packet = av_packet_alloc();
+	if (!h->dec || !h->frame || !h->packet || avcodec_open2(h->dec, decoder, nullptr) < 0) {
+		blog(LOG_WARNING, "[" PLUGIN_ID "] Could not open H.264 decoder");
+		h264_close(h);
+		return false;
+	}
+
+	// 4:2:0 needs an even height, odd frames get their last row repeated. The
+	// rate is nominal; frames go in as fast as the worker gets them.
+	video_output_info voi = {};
+	voi.name = LOOPER_H264_OUTPUT_ID;
+	voi.format = VIDEO_FORMAT_NV12;
+	voi.fps_num = 30;
+	voi.fps_den = 1;
+	voi.width = width;
+	voi.height = (height + 1) & ~1u;
+	voi.cache_size = 2;
+	voi.colorspace = VIDEO_CS_DEFAULT;
+	voi.range = VIDEO_RANGE_DEFAULT;
+	if (video_output_open(&h->video, &voi) != VIDEO_OUTPUT_SUCCESS) {
+		h->video = nullptr;
+		blog(LOG_WARNING, "[" PLUGIN_ID "] Could not open a %ux%u video output for H.264", width, height);
+		h264_close(h);
+		return false;
+	}
+
+	// No B-frames and no lookahead, so each frame's packet comes straight back.
+	// Headers repeat on every keyframe so each GOP decodes on its own.
+	char options[64];
+	snprintf(options, sizeof(options), "keyint=%d min-keyint=%d scenecut=0 bframes=0", LOOPER_GOP_FRAMES,
+		 LOOPER_GOP_FRAMES);
+	obs_data_t *settings = obs_data_create();
+	obs_data_set_string(settings, "rate_control", "CRF");
+	obs_data_set_int(settings, "crf", 18);
+	obs_data_set_string(settings, "preset", "veryfast");
+	obs_data_set_string(settings, "tune", "zerolatency");
+	obs_data_set_bool(settings, "repeat_headers", true);
+	obs_data_set_string(settings, "x264opts", options);
+	h->encoder = obs_video_encoder_create("obs_x264", LOOPER_H264_OUTPUT_ID, settings, nullptr);
+	obs_data_release(settings);
+	h->output = obs_output_create(LOOPER_H264_OUTPUT_ID, LOOPER_H264_OUTPUT_ID, nullptr, nullptr);
+	if (h->encoder && h->output) {
+		obs_encoder_set_video(h->encoder, h->video);
+		obs_output_set_video_encoder(h->output, h->encoder);
+	}
+	if (!h->encoder || !h->output || !obs_output_start(h->output)) {
+		const char *error = h->output ? obs_output_get_last_error(h->output) : nullptr;
+		blog(LOG_WARNING, "[" PLUGIN_ID "] Could not start H.264 encoder for %ux%u frames%s%s", width, height,
+		     error ? ": " : "", error ? error : "");
+		h264_close(h);
+		return false;
+	}
+
+	h->width = width;
+	h->height = height;
+	return true;
+}
+
+// Encode one frame into one packet
+static frame_buffer h264_encode(h264_codec *h, const codec_job &job, bool *keyframe)
+{
+	if (!h264_open(h, job.width, job.height))
+		return nullptr;
+
+	auto *sink = static_cast<h264_sink *>(obs_obj_get_data(h->output));
+	{
+		std::lock_guard<std::mutex> lk(sink->mtx);
+		sink->packets.clear();
+	}
+
+	video_frame f;
+	uint64_t timestamp = (h->frames + 1) * 1000000000ULL / 30;
+	if (!video_output_lock_frame(h->video, &f, 1, timestamp))
+		return nullptr;
+	h->frames++;
+
+	const uint8_t *src = job.in->data();
+	uint32_t rows = (job.height + 1) & ~1u;
+	for (uint32_t y = 0; y < rows; ++y) {
+		uint32_t row = y < job.height ? y : job.height - 1;
+		memcpy(f.data[0] + (size_t)y * f.linesize[0], src + (size_t)row * job.width, job.width);
+	}
+	const uint8_t *chroma = src + (size_t)job.height * job.width;
+	for (uint32_t y = 0; y < (job.height + 1) / 2; ++y)
+		memcpy(f.data[1] + (size_t)y * f.linesize[1], chroma + (size_t)y * job.width, job.width);
+	video_output_unlock_frame(h->video);
+
+	std::unique_lock<std::mutex> lk(sink->mtx);
+	if (!sink->cv.wait_for(lk, std::chrono::milliseconds(LOOPER_H264_PACKET_TIMEOUT_MS),
+			       [sink]() { return !sink->packets.empty(); }))
+		return nullptr;
+	h264_packet packet = std::move(sink->packets.front());
+	sink->packets.pop_front();
+	*keyframe = packet.keyframe;
+	return packet.data;
+}
+
+// Copy a decoded picture into the NV12 storage layout
+static bool h264_copy_picture(const AVFrame *f, uint8_t *dst, uint32_t width, uint32_t height)
+{
+	if (f->width < (int)width || f->height < (int)height)
+		return false;
+
+	for (uint32_t y = 0; y < height; ++y)
+		memcpy(dst + (size_t)y * width, f->data[0] + (size_t)y * f->linesize[0], width);
+
+	uint8_t *chroma = dst + (size_t)height * width;
+	for (uint32_t y = 0; y < (height + 1) / 2; ++y) {
+		uint8_t *row = chroma + (size_t)y * width;
+		if (f->format == AV_PIX_FMT_NV12) {
+			memcpy(row, f->data[1] + (size_t)y * f->linesize[1], width);
+			continue;
+		}
+		const uint8_t *u = f->data[1] + (size_t)y * f->linesize[1];
+		const uint8_t *v = f->data[2] + (size_t)y * f->linesize[2];
+		for (uint32_t x = 0; x < width / 2; ++x) {
+			row[x * 2] = u[x];
+			row[x * 2 + 1] = v[x];
+		}
+	}
+	return true;
+}
+
+// Decode a whole GOP, filling job.outs in display order. Returns the number of
+// frames decoded.
+static size_t h264_decode_gop(h264_codec *h, codec_job &job)
+{
+	if (!h264_open(h, job.width, job.height))
+		return 0;
+
+	job.outs.resize(job.packets.size());
+	size_t decoded = 0;
+	auto receive = [&]() {
+		while (avcodec_receive_frame(h->dec, h->frame) == 0) {
+			if (decoded < job.outs.size()) {
+				frame_buffer &out = job.outs[decoded];
+				if (!out)
+					out = std::make_shared<std::vector<uint8_t>>();
+				out->resize(job.raw_bytes);
+				if (h264_copy_picture(h->frame, out->data(), job.width, job.height))
+					decoded++;
+			}
+			av_frame_unref(h->frame);
+		}
+	};
+
+	// Every GOP decodes from a clean decoder state
+	avcodec_flush_buffers(h->dec);
+	for (auto &packet : job.packets) {
+		h->packet->data = packet->data();
+		h->packet->size = (int)packet->size();
+		avcodec_send_packet(h->dec, h->packet);
+		receive();
+	}
+	h->packet->data = nullptr;
+	h->packet->size = 0;
+	avcodec_send_packet(h->dec, nullptr);
+	receive();
+	avcodec_flush_buffers(h->dec);
+	return decoded;
+}
+
+static void h264_run_job(frame_codec *codec, h264_codec *h, codec_job &job)
+{
+	uint64_t start = os_gettime_ns();
+
+	if (!job.decode) {
+		bool keyframe = false;
+		frame_buffer packed = h264_encode(h, job, &keyframe);
+		uint64_t elapsed = os_gettime_ns() - start;
+
+		// A frame that failed to encode stays raw, so no later frame may be coded
+		// against the encoder's state around it. Reopening the encoder makes the
+		// next frame a keyframe that starts a new GOP.
+		if (!packed && h->output) {
+			blog(LOG_WARNING, "[" PLUGIN_ID "] H.264 encode failed, frame kept raw and a new GOP started");
+			h264_close(h);
+		}
+
+		std::lock_guard<std::mutex> lk(codec->mtx);
+		codec->stats.encoded++;
+		codec->stats.encode_ns += elapsed;
+		if (packed) {
+			codec->stats.raw_bytes += job.in->size();
+			codec->stats.packed_bytes += packed->size();
+		}
+		codec->done.push_back({job.seq, std::move(job.in), std::move(packed), keyframe});
+		return;
+	}
+
+	size_t decoded = h264_decode_gop(h, job);
+	uint64_t elapsed = os_gettime_ns() - start;
+
+	std::lock_guard<std::mutex> lk(codec->mtx);
+	codec->stats.decoded += decoded;
+	codec->stats.decode_ns += elapsed;
+	for (size_t i = 0; i < job.packets.size(); ++i)
+		codec_store_decoded(codec, job.seq + i, job.outs[i], i < decoded);
+}
+#endif
+
+static void codec_worker(frame_codec *codec)
+{
+	std::vector<uint8_t> scratch;
+#ifdef LOOPER_ENCODED_RING
+	h264_codec h264;
+#endif
+
+	for (;;) {
+		codec_job job;
+		{
+			std::unique_lock<std::mutex> lk(codec->mtx);
+			codec->cv.wait(lk, [codec]() { return codec->stop || !codec->jobs.empty(); });
+			if (codec->stop)
+				break;
+			job = std::move(codec->jobs.front());
+			codec->jobs.pop_front();
+		}
+
+#ifdef LOOPER_ENCODED_RING
+		if (codec->kind == OVERFLOW_ENCODED) {
+			h264_run_job(codec, &h264, job);
+			continue;
+		}
+#endif
+
+		uint64_t start = os_gettime_ns();
+
+		if (!job.decode) {
+			scratch.resize(qoi_max_size(job.in->size()));
+			size_t size = qoi_encode(job.in->data(), job.in->size(), scratch.data());
+			auto packed = std::make_shared<std::vector<uint8_t>>(scratch.begin(), scratch.begin() + size);
+			uint64_t elapsed = os_gettime_ns() - start;
+
+			std::lock_guard<std::mutex> lk(codec->mtx);
+			codec->stats.encoded++;
+			codec->stats.encode_ns += elapsed;
+			codec->stats.raw_bytes += job.in->size();
+			codec->stats.packed_bytes += size;
+			codec->done.push_back({job.seq, std::move(job.in), std::move(packed)});
+			continue;
+		}
+
+		frame_buffer pixels = job.out ? std::move(job.out) : std::make_shared<std::vector<uint8_t>>();
+		pixels->resize(job.raw_bytes);
+		bool ok = qoi_decode(job.in->data(), job.in->size(), pixels->data(), job.raw_bytes);
+		uint64_t elapsed = os_gettime_ns() - start;
+
+		std::lock_guard<std::mutex> lk(codec->mtx);
+		codec->stats.decoded++;
+		codec->stats.decode_ns += elapsed;
+		codec_store_decoded(codec, job.seq, pixels, ok);
+	}
+
+#ifdef LOOPER_ENCODED_RING
+	h264_close(&h264);
+#endif
+}
+
+static void codec_start(frame_codec *codec, int kind)
+{
+	// H.264 is a stream, so one thread runs it (the codec threads internally)
+	unsigned threads = std::thread::hardware_concurrency() / 2;
+	threads = kind == OVERFLOW_ENCODED ? 1 : clampv(threads, 1u, 4u);
+
+	// GOP decodes keep the cursor's GOP, the next one and part of the last
+	codec->kind = kind;
+	codec->cache.assign(kind == OVERFLOW_ENCODED ? LOOPER_GOP_FRAMES * 3 : LOOPER_DECODE_AHEAD * 2,
+			    decoded_frame());
+	codec->stop = false;
+	for (unsigned i = 0; i < threads; ++i)
+		codec->workers.emplace_back(codec_worker, codec);
+}
+
+// Stop the workers and drop queued work, finished results and decoded frames
+static void codec_stop(frame_codec *codec)
+{
+	{
+		std::lock_guard<std::mutex> lk(codec->mtx);
+		codec->stop = true;
+	}
+	codec->cv.notify_all();
+	for (auto &worker : codec->workers)
+		worker.join();
+	codec->workers.clear();
+
+	codec->jobs.clear();
+	codec->done.clear();
+	codec->cache.clear();
+	codec->stats = {};
+	codec->kind = OVERFLOW_NONE;
+}
+
+static void codec_submit(frame_codec *codec, codec_job &&job)
+{
+	{
+		std::lock_guard<std::mutex> lk(codec->mtx);
+		codec->jobs.push_back(std::move(job));
+	}
+	codec->cv.notify_one();
+}
+
+// --------------------------- Filter State ----------------------------
+
+// Weight of a filter's claim on the shared VRAM budget
+enum budget_priority {
+	PRIORITY_LOW = 1,
+	PRIORITY_NORMAL = 2,
+	PRIORITY_HIGH = 4,
+};
+
+struct loop_filter {
+	obs_source_t *context = nullptr;
+
+	// Settings
+	int buffer_seconds = 30; // 10–60, up to 600 with the disk tier
+	bool ping_pong = true;
+	bool loop_enabled = false;
+	double playback_speed = 1.0;         // 0.01–64x
+	int storage = STORAGE_RGBA;          // frame_storage
+	int overflow = OVERFLOW_NONE;        // overflow_tier
+	bool async_capture = true;           // Buffer async sources' own frames instead of capturing renders
+	int vram_priority = PRIORITY_NORMAL; // budget_priority
+	int eviction = EVICT_OLDEST;         // eviction_policy
+	int interpolation = INTERP_NONE;     // playback_interpolation
+	bool seamless_loop = false;          // Forward loops run between the best-matching frames
+	bool exit_on_match = false;          // Stopping waits for a buffered frame that matches live
+	int crossfade_frames = 0;            // Forward loops: frames crossfaded over the wrap, 0 for none
+	double ease_seconds = 0.0;           // Ping-pong: clock seconds of each slow-down into a turn, 0 for none
+
+	// Derived
+	uint32_t base_w = 0;
+	uint32_t base_h = 0;
+	double fps = 60.0;
+	size_t max_frames = 0;
+	int capture_skip_frames = 2;   // Capture every Nth frame
+	double capture_stretch = 1.0; // Thinned buffers capture further apart than that
+	bool async_mode = false;      // Parent is an async source buffered through loop_filter_video()
+
+	// Capture + Playback, sized in recalc_buffer()
+	frame_ring<gs_texrender_t *> vram;     // Newest frames as render targets, plus one spare capture slot
+	frame_ring<gs_stagesurf_t *> readback; // Frames on their way from VRAM to host memory
+	frame_ring<host_frame> host;           // Oldest frames, spilled to system RAM or the disk cache
+	frame_meta_table meta;                 // Per-frame metadata, rows aligned with the logical frame index
+	frame_ring<signature_probe> probes;    // Thumbnails being read back for the metadata
+	frame_ring<obs_source_frame *> async_frames; // Async mode: copies of the parent's frames, the only tier
+	size_t async_bytes = 0;                      // Async mode: bytes held by async_frames
+	size_t vram_frames = 0;                // Frame limit of each tier
+	size_t host_frames = 0;
+	size_t frame_count = 0;                    // Frames across all tiers
+	int ring_storage = STORAGE_RGBA;           // Storage mode the slots were created for
+	int host_kind = OVERFLOW_NONE;             // Overflow tier the host slots were created for
+	mapped_file disk;                          // Backing file of a disk host tier
+	size_t disk_frame_bytes = 0;               // Size of each frame slot in the disk cache
+	frame_codec codec;                         // Compressed tier workers
+	size_t host_bytes = 0;                     // Compressed tier: bytes held by host frames
+	uint64_t next_seq = 0;                     // Compressed tier: sequence number of the next host frame
+	std::vector<frame_buffer> raw_pool;        // Compressed tier: raw frame buffers free for reuse
+	frame_buffer decode_scratch;               // Compressed tier: frames decoded on the render thread
+	uint64_t codec_reported = 0;               // Encoded frame count at the last codec stats log
+	bool ram_limit_logged = false;
+	uint64_t capture_serial = 0;               // Capture number of the next commit
+	uint8_t last_thumb[LOOPER_THUMB_BYTES];    // Newest measured thumbnail
+	uint64_t last_thumb_serial = UINT64_MAX;   // Capture number of last_thumb
+	gs_texrender_t *capture_scratch = nullptr; // Full-quality capture target for packed storage modes
+	gs_texture_t *upload_tex = nullptr;        // Host-tier frame currently uploaded for playback
+	size_t upload_index = SIZE_MAX;            // Logical index held by upload_tex
+	gs_texture_t *blend_tex = nullptr;         // Host-tier frame blended into it
+	size_t blend_upload_index = SIZE_MAX;      // Logical index held by blend_tex
+	flow_luma flow_lumas[LOOPER_FLOW_CACHE];   // Motion-compensated playback caches
+	flow_field flow_fields[LOOPER_FLOW_CACHE];
+	uint64_t flow_clock = 0;
+	gpu_pass_timer capture_gpu;  // GPU time of capture passes
+	gpu_pass_timer playback_gpu; // GPU time of playback passes
+	std::mutex frames_mtx;
+
+	gs_effect_t *effect = nullptr; // looper.effect: storage pack/unpack passes
+
+	// Playback cursor
+	size_t play_index = 0;  // 0..frame_count-1 (0 = oldest)
+	int direction = +1;     // +1 forward, -1 backward
+	double play_time = 0.0; // Position in ns on the content clock, from the oldest frame
+	int total_loops = 0;    // Track how many times we've looped
+	size_t blend_index = SIZE_MAX; // Frame blended into play_index, SIZE_MAX for none
+	float blend_weight = 0.0f;     // Weight of blend_index, 0-1
+	bool crossfading = false;      // blend_index is the crossfade partner rather than the next frame
+	size_t loop_first = 0;         // Forward loops play frames [loop_first, loop_end)
+	size_t loop_end = 0;           // ... 0 for the whole buffer
+
+	// Stopping on a frame that matches live, see check_loop_exit_locked()
+	bool exit_pending = false;              // Stop requested, playback continues until a match
+	uint64_t exit_requested_at = 0;         // os_gettime_ns() of the request
+	uint8_t live_thumb[LOOPER_THUMB_BYTES]; // Newest thumbnail of the live picture while waiting
+	bool live_thumb_valid = false;
+	gs_texrender_t *live_target = nullptr; // Rendered parents: the live picture while waiting
+	signature_probe live_probe;            // ... and its thumbnail on the way back, serial 1 when staged
+
+	// Loop clock the cursor is derived from, see advance_playback_locked()
+	double loop_clock = 0.0;           // Content ns played since the cursor was placed
+	double loop_phase = 0.0;           // Wave phase the cursor was placed at
+	double loop_shape_period = 0.0;    // Period of the wave the phase belongs to
+	bool loop_shape_ping_pong = false; // ... and whether it is a triangle wave
+	int loops_placed = 0;              // total_loops when the cursor was placed
+
+	// Sync group: the loop clock comes from the group instead, see sync_advance()
+	std::string sync_group_setting; // Set by loop_filter_update(), guarded by frames_mtx
+	std::string sync_group;         // Group joined by the tick, empty for none
+	double sync_speed_seen = 1.0;   // playback_speed setting last passed on to the group
+
+	// Hotkey
+	obs_hotkey_id hotkey_toggle = OBS_INVALID_HOTKEY_ID;
+
+	// Frame capture state
+	bool shown = true; // Between show and hide; hidden filters hold no frames
+	bool dimensions_valid = false;
+	int frame_skip_counter = 0;        // To reduce capture rate
+	uint64_t next_capture_time = 0;    // Capture schedule: due time of the next capture, 0 to start over
+	bool parent_async = false;         // Parent delivers async frames, seen by loop_filter_video()
+	bool source_frame_pending = false; // Async parent: a new frame arrived since the last capture
+	uint64_t source_frame_time = 0;    // Async parent: timestamp of that frame
+
+	// UI state - removed toggle_button pointer to avoid lifetime issues
+	double last_ui_update = 0.0;        // Track last UI update time
+	uint64_t capture_start_time = 0;    // Track when capture started (nanoseconds)
+	size_t frames_captured_count = 0;   // Track total frames captured
+	size_t last_logged_frame_count = 0; // Track last frame count for UI updates
+
+	// Resource management
+	size_t max_memory_mb = 0;         // VRAM share granted by the module budget, applied by recalc_buffer()
+	std::atomic<size_t> budget_mb{0}; // Latest VRAM share, updated when other filters rebalance
+	std::atomic<size_t> owned_vram_bytes{0}; // Allocated size of every texture the filter owns
+	float vram_check_elapsed = 0.0f;         // Seconds since owned_vram_bytes was measured
+	size_t max_ram_mb = 8192;         // System RAM limit for the overflow tier
+	size_t max_disk_mb = 65536;       // Cache file limit for the disk tier
+	size_t current_memory_usage = 0;  // Track current memory usage
+	uint32_t last_width = 0;          // Track resolution changes
+	uint32_t last_height = 0;
+};
+
+// ----------------------------- Forward Decls -----------------------------
+
+static const char *loop_filter_get_name(void *);
+static void *loop_filter_create(obs_data_t *settings, obs_source_t *context);
+static void loop_filter_destroy(void *data);
+static void loop_filter_update(void *data, obs_data_t *settings);
+static obs_properties_t *loop_filter_properties(void *data);
+static void loop_filter_get_defaults(obs_data_t *settings);
+static void loop_filter_tick(void *data, float seconds);
+static void loop_filter_render(void *data, gs_effect_t *effect);
+static struct obs_source_frame *loop_filter_video(void *data, struct obs_source_frame *frame);
+static void loop_filter_show(void *data);
+static void loop_filter_hide(void *data);
+
+// Hotkey
+static void loop_filter_register_hotkeys(loop_filter *lf);
+static void loop_filter_toggle_cb(void *data, obs_hotkey_id id, obs_hotkey_t *hotkey, bool pressed);
+
+// ----------------------------- Texture Pool -----------------------------
+
+// Frame render targets handed back by hidden or destroyed filters, kept for any
+// filter that needs a target of the same size and format. Identical sources
+// switching scenes then trade targets instead of freeing and reallocating them,
+// so VRAM stays flat. Targets idle for LOOPER_POOL_IDLE_NS are released.
+// Call with the graphics context entered; the pool mutex comes after frames_mtx.
+
+#define LOOPER_POOL_IDLE_NS 30000000000ull
+
+struct pooled_target {
+	gs_texrender_t *target;
+	gs_color_format format;
+	uint32_t width;
+	uint32_t height;
+	size_t bytes;
+	uint64_t returned; // os_gettime_ns() when it entered the pool
+};
+
+struct texture_pool {
+	std::mutex mtx;
+	std::vector<pooled_target> targets;
+	size_t bytes = 0; // Allocated size of all pooled targets
+};
+
+static texture_pool module_pool;
+
+// A render target whose texture is 'width' x 'height' in 'format', from the pool
+// if one is free, else a new one that allocates its texture on first use
+static gs_texrender_t *pool_take(gs_color_format format, uint32_t width, uint32_t height)
+{
+	{
+		std::lock_guard<std::mutex> lk(module_pool.mtx);
+		auto &targets = module_pool.targets;
+		// Most recently returned first, its texture is the likeliest to still be resident
+		for (size_t i = targets.size(); i-- > 0;) {
+			pooled_target &t = targets[i];
+			if (t.format != format || t.width != width || t.height != height)
+				continue;
+			gs_texrender_t *target = t.target;
+			module_pool.bytes -= t.bytes;
+			targets.erase(targets.begin() + (ptrdiff_t)i);
+			return target;
+		}
+	}
+	return gs_texrender_create(format, GS_ZS_NONE);
+}
+
+static void pool_give(gs_texrender_t *target)
+{
+	if (!target)
+		return;
+
+	// Targets that were never rendered hold no VRAM and aren't worth keeping
+	gs_texture_t *tex = gs_texrender_get_texture(target);
+	if (!tex) {
+		gs_texrender_destroy(target);
+		return;
+	}
+
+	pooled_target t;
+	t.target = target;
+	t.format = gs_texture_get_color_format(tex);
+	t.width = gs_texture_get_width(tex);
+	t.height = gs_texture_get_height(tex);
+	t.bytes = texture_alloc_bytes(t.format, t.width, t.height);
+	t.returned = os_gettime_ns();
+
+	std::lock_guard<std::mutex> lk(module_pool.mtx);
+	module_pool.targets.push_back(t);
+	module_pool.bytes += t.bytes;
+}
+
+// Release targets idle since before 'cutoff' (os_gettime_ns() time), all with UINT64_MAX
+static void pool_trim(uint64_t cutoff)
+{
+	std::lock_guard<std::mutex> lk(module_pool.mtx);
+	auto &targets = module_pool.targets;
+	size_t released = 0;
+	size_t released_bytes = 0;
+	for (size_t i = targets.size(); i-- > 0;) {
+		if (targets[i].returned >= cutoff)
+			continue;
+		gs_texrender_destroy(targets[i].target);
+		released_bytes += targets[i].bytes;
+		module_pool.bytes -= targets[i].bytes;
+		targets.erase(targets.begin() + (ptrdiff_t)i);
+		released++;
+	}
+	if (released > 0)
+		blog(LOG_INFO, "[" PLUGIN_ID "] Texture pool released %zu idle targets (%zuMB), %zu remain", released,
+		     released_bytes / (1024 * 1024), targets.size());
+}
+
+static size_t pool_bytes(void)
+{
+	std::lock_guard<std::mutex> lk(module_pool.mtx);
+	return module_pool.bytes;
+}
+
+// ----------------------------- VRAM Budget -----------------------------
+
+// Every Looper instance in the process draws its render targets from one VRAM
+// budget. Each visible filter asks for what its buffer would need; the budget
+// is shared out by priority weight, and filters asking for less than their
+// share leave the rest to the others (weighted max-min fairness). Hidden
+// filters have freed their frames and claim nothing.
+//
+// Shares are pushed to each filter's budget_mb and picked up by its own tick,
+// so a rebalance never resizes another filter from the calling thread. Lock
+// order: budget mutex, then the graphics context, then frames_mtx.
+//
+// The budget itself is what Looper already holds plus the GPU's free memory
+// minus a reserve, re-measured every few seconds where the graphics backend
+// reports free memory. Elsewhere it stays at LOOPER_VRAM_BUDGET_MB.
+
+#define LOOPER_VRAM_BUDGET_MB 4096
+#define LOOPER_VRAM_RESERVE_MB 512          // Kept free for OBS and other applications, at least
+#define LOOPER_VRAM_MEASURE_NS 2000000000ull // Interval between free memory queries
+
+struct budget_entry {
+	loop_filter *lf;
+	size_t demand_mb; // VRAM the filter's full buffer would take
+	int weight;       // budget_priority
+	bool shown;
+	size_t share_mb;
+};
+
+struct vram_budget {
+	std::mutex mtx;
+	size_t total_mb = LOOPER_VRAM_BUDGET_MB;
+	bool measured = false;      // total_mb follows the GPU's free memory
+	bool query_failed = false;  // The backend can't report free memory
+	uint64_t last_measure = 0;  // os_gettime_ns() of the last query
+	std::vector<budget_entry> entries;
+};
+
+static vram_budget module_budget;
+
+static void budget_rebalance_locked()
+{
+	vram_budget &b = module_budget;
+	std::vector<size_t> shares(b.entries.size(), 0);
+	std::vector<bool> settled(b.entries.size(), false);
+
+	// Water-filling: settle every filter that fits in its weighted share of what
+	// is left, then share the remainder among the others again
+	for (;;) {
+		size_t remaining = b.total_mb;
+		size_t weights = 0;
+		for (size_t i = 0; i < b.entries.size(); ++i) {
+			const budget_entry &e = b.entries[i];
+			if (!e.shown || e.demand_mb == 0)
+				settled[i] = true;
+			if (settled[i])
+				remaining -= shares[i] < remaining ? shares[i] : remaining;
+			else
+				weights += (size_t)e.weight;
+		}
+		if (weights == 0)
+			break;
+
+		bool settled_any = false;
+		for (size_t i = 0; i < b.entries.size(); ++i) {
+			if (settled[i])
+				continue;
+			size_t fair = (size_t)(((uint64_t)remaining * b.entries[i].weight) / weights);
+			if (b.entries[i].demand_mb <= fair) {
+				shares[i] = b.entries[i].demand_mb;
+				settled[i] = true;
+				settled_any = true;
+			} else {
+				shares[i] = fair;
+			}
+		}
+		if (!settled_any)
+			break;
+	}
+
+	for (size_t i = 0; i < b.entries.size(); ++i) {
+		budget_entry &e = b.entries[i];
+		if (e.share_mb != shares[i] && e.demand_mb > 0 && e.shown)
+			blog(LOG_INFO, "[" PLUGIN_ID "] VRAM budget: '%s' gets %zuMB of %zuMB (needs %zuMB, %zu filters)",
+			     obs_source_get_name(e.lf->context), shares[i], b.total_mb, e.demand_mb, b.entries.size());
+		e.share_mb = shares[i];
+		e.lf->budget_mb = shares[i];
+	}
+}
+
+static budget_entry *budget_find_locked(loop_filter *lf)
+{
+	for (auto &e : module_budget.entries) {
+		if (e.lf == lf)
+			return &e;
+	}
+	return nullptr;
+}
+
+static void budget_register(loop_filter *lf)
+{
+	std::lock_guard<std::mutex> lk(module_budget.mtx);
+	module_budget.entries.push_back({lf, 0, lf->vram_priority, true, 0});
+}
+
+// Returns the number of filters still registered
+static size_t budget_unregister(loop_filter *lf)
+{
+	std::lock_guard<std::mutex> lk(module_budget.mtx);
+	auto &entries = module_budget.entries;
+	entries.erase(std::remove_if(entries.begin(), entries.end(),
+				     [lf](const budget_entry &e) { return e.lf == lf; }),
+		      entries.end());
+	budget_rebalance_locked();
+	return entries.size();
+}
+
+// Publish what the filter's buffer needs and return its share of the budget
+static size_t budget_request(loop_filter *lf, size_t demand_mb)
+{
+	std::lock_guard<std::mutex> lk(module_budget.mtx);
+	budget_entry *e = budget_find_locked(lf);
+	if (!e)
+		return module_budget.total_mb;
+	e->demand_mb = demand_mb;
+	e->weight = lf->vram_priority;
+	budget_rebalance_locked();
+	return e->share_mb;
+}
+
+static void budget_set_shown(loop_filter *lf, bool shown)
+{
+	std::lock_guard<std::mutex> lk(module_budget.mtx);
+	budget_entry *e = budget_find_locked(lf);
+	if (!e || e->shown == shown)
+		return;
+	e->shown = shown;
+	budget_rebalance_locked();
+}
+
+// Free and total video memory in MB, where the graphics backend exposes them.
+// Must be called inside the graphics context.
+#ifdef _WIN32
+static bool query_gpu_memory(size_t *free_mb, size_t *total_mb)
+{
+	if (gs_get_device_type() != GS_DEVICE_DIRECT3D_11)
+		return false;
+	auto *device = reinterpret_cast<ID3D11Device *>(gs_get_device_obj());
+	if (!device)
+		return false;
+
+	// DXGI 1.4 reports the OS's video memory budget for this process and its usage
+	bool ok = false;
+	IDXGIDevice *dxgi_device = nullptr;
+	IDXGIAdapter *adapter = nullptr;
+	IDXGIAdapter3 *adapter3 = nullptr;
+	if (SUCCEEDED(device->QueryInterface(__uuidof(IDXGIDevice), (void **)&dxgi_device)) &&
+	    SUCCEEDED(dxgi_device->GetAdapter(&adapter)) &&
+	    SUCCEEDED(adapter->QueryInterface(__uuidof(IDXGIAdapter3), (void **)&adapter3))) {
+		DXGI_QUERY_VIDEO_MEMORY_INFO info = {};
+		if (SUCCEEDED(adapter3->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &info))) {
+			uint64_t avail = info.Budget > info.CurrentUsage ? info.Budget - info.CurrentUsage : 0;
+			*free_mb = (size_t)(avail / (1024 * 1024));
+			*total_mb = (size_t)(info.Budget / (1024 * 1024));
+			ok = true;
+		}
+	}
+	if (adapter3)
+		adapter3->Release();
+	if (adapter)
+		adapter->Release();
+	if (dxgi_device)
+		dxgi_device->Release();
+	return ok;
+}
+#else
+#define LOOPER_GL_TOTAL_AVAILABLE_MEMORY_NVX 0x9048
+#define LOOPER_GL_CURRENT_AVAILABLE_VIDMEM_NVX 0x9049
+#define LOOPER_GL_TEXTURE_FREE_MEMORY_ATI 0x87FC
+
+typedef void (*gl_get_integerv_fn)(unsigned int pname, int *data);
+typedef unsigned int (*gl_get_error_fn)(void);
+
+static bool query_gpu_memory(size_t *free_mb, size_t *total_mb)
+{
+	if (gs_get_device_type() != GS_DEVICE_OPENGL)
+		return false;
+
+	// libobs-opengl has already loaded the GL library; never load one ourselves
+	static gl_get_integerv_fn get_integerv = nullptr;
+	static gl_get_error_fn get_error = nullptr;
+	static bool resolved = false;
+	if (!resolved) {
+		resolved = true;
+		const char *libs[] = {"libGL.so.1", "libOpenGL.so.0", "libGL.so"};
+		for (const char *lib : libs) {
+			void *handle = dlopen(lib, RTLD_LAZY | RTLD_NOLOAD);
+			if (!handle)
+				continue;
+			get_integerv = (gl_get_integerv_fn)dlsym(handle, "glGetIntegerv");
+			get_error = (gl_get_error_fn)dlsym(handle, "glGetError");
+			dlclose(handle);
+			if (get_integerv && get_error)
+				break;
+		}
+	}
+	if (!get_integerv || !get_error)
+		return false;
+
+	// Unsupported queries raise GL_INVALID_ENUM, which must not leak into
+	// libobs's own error checks
+	while (get_error() != 0) {
+	}
+
+	// GL_NVX_gpu_memory_info, values in KB
+	int free_kb = 0;
+	int total_kb = 0;
+	get_integerv(LOOPER_GL_CURRENT_AVAILABLE_VIDMEM_NVX, &free_kb);
+	if (get_error() == 0 && free_kb > 0) {
+		get_integerv(LOOPER_GL_TOTAL_AVAILABLE_MEMORY_NVX, &total_kb);
+		get_error();
+		*free_mb = (size_t)free_kb / 1024;
+		*total_mb = total_kb > 0 ? (size_t)total_kb / 1024 : 0;
+		return true;
+	}
+
+	// GL_ATI_meminfo: free KB of the texture pool first, no total
+	int ati[4] = {0, 0, 0, 0};
+	get_integerv(LOOPER_GL_TEXTURE_FREE_MEMORY_ATI, ati);
+	if (get_error() == 0 && ati[0] > 0) {
+		*free_mb = (size_t)ati[0] / 1024;
+		*total_mb = 0;
+		return true;
+	}
+	return false;
+}
+#endif
+
+// Re-measure the GPU's free memory, at most every LOOPER_VRAM_MEASURE_NS across
+// all filters, and rebalance when the budget moved by more than a tenth
+static void budget_measure(void)
+{
+	vram_budget &b = module_budget;
+	{
+		std::lock_guard<std::mutex> lk(b.mtx);
+		uint64_t now = os_gettime_ns();
+		if (b.query_failed || (b.last_measure != 0 && now - b.last_measure < LOOPER_VRAM_MEASURE_NS))
+			return;
+		b.last_measure = now;
+	}
+
+	size_t free_mb = 0;
+	size_t total_mb = 0;
+	obs_enter_graphics();
+	bool ok = query_gpu_memory(&free_mb, &total_mb);
+	obs_leave_graphics();
+
+	std::lock_guard<std::mutex> lk(b.mtx);
+	if (!ok) {
+		b.query_failed = true;
+		blog(LOG_INFO, "[" PLUGIN_ID "] GPU free memory not reported by this graphics backend, VRAM budget stays %zuMB",
+		     b.total_mb);
+		return;
+	}
+
+	// What Looper holds, pooled targets included, is available to Looper; the reserve stays free
+	size_t owned_mb = pool_bytes() / (1024 * 1024);
+	for (const auto &e : b.entries)
+		owned_mb += e.lf->owned_vram_bytes / (1024 * 1024);
+	size_t reserve_mb = total_mb / 10 > LOOPER_VRAM_RESERVE_MB ? total_mb / 10 : LOOPER_VRAM_RESERVE_MB;
+	size_t budget_mb = owned_mb + (free_mb > reserve_mb ? free_mb - reserve_mb : 0);
+
+	size_t change = budget_mb > b.total_mb ? budget_mb - b.total_mb : b.total_mb - budget_mb;
+	if (b.measured && change * 10 <= b.total_mb)
+		return;
+
+	blog(LOG_INFO,
+	     "[" PLUGIN_ID "] VRAM budget %zuMB -> %zuMB (GPU free %zuMB of %zuMB, Looper holds %zuMB, reserve %zuMB)",
+	     b.total_mb, budget_mb, free_mb, total_mb, owned_mb, reserve_mb);
+	b.total_mb = budget_mb;
+	b.measured = true;
+	budget_rebalance_locked();
+}
+
+// ----------------------------- Sync Groups -----------------------------
+
+// Filters sharing a sync group name share one loop clock, so loops of several
+// cameras recorded together show the same moment. The group holds the wave
+// phase and the content time played since, advanced once per video frame by
+// whichever member ticks first; each member maps that phase onto its own
+// buffer. A group whose members all stopped looping goes idle, and the next
+// member to loop carries on from its own position. Lock order: frames_mtx,
+// then the sync mutex.
+
+#define LOOPER_SYNC_IDLE_NS 250000000ull // Group clock stops when no member has ticked for this long
+
+struct sync_group {
+	std::string name;
+	size_t members = 0;
+	double phase = 0.0;     // Wave phase at clock 0
+	double clock = 0.0;     // Content ns played since
+	double speed = 1.0;     // playback_speed, changed by any member
+	int direction = -1;     // Forward loops: +1 forward, -1 backward
+	uint64_t ticked_at = 0; // Video frame time of the last advance, 0 while idle
+};
+
+struct sync_registry {
+	std::mutex mtx;
+	std::vector<sync_group> groups;
+};
+
+static sync_registry module_sync;
+
+static sync_group *sync_find_locked(const std::string &name)
+{
+	for (auto &g : module_sync.groups) {
+		if (g.name == name)
+			return &g;
+	}
+	return nullptr;
+}
+
+static void sync_join(const std::string &name)
+{
+	std::lock_guard<std::mutex> lk(module_sync.mtx);
+	sync_group *g = sync_find_locked(name);
+	if (!g) {
+		module_sync.groups.emplace_back();
+		g = &module_sync.groups.back();
+		g->name = name;
+	}
+	g->members++;
+	blog(LOG_INFO, "[" PLUGIN_ID "] Joined sync group '%s' (%zu members)", name.c_str(), g->members);
+}
+
+static void sync_leave(const std::string &name)
+{
+	std::lock_guard<std::mutex> lk(module_sync.mtx);
+	auto &groups = module_sync.groups;
+	for (size_t i = 0; i < groups.size(); ++i) {
+		if (groups[i].name != name)
+			continue;
+		if (--groups[i].members == 0)
+			groups.erase(groups.begin() + (ptrdiff_t)i);
+		break;
+	}
+}
+
+// Follow the group named in the settings. Leaving keeps the member's cursor
+// where the group had it, so playback carries on without a jump.
+static void sync_apply_setting_locked(loop_filter *lf)
+{
+	if (lf->sync_group == lf->sync_group_setting)
+		return;
+	if (!lf->sync_group.empty())
+		sync_leave(lf->sync_group);
+	lf->sync_group = lf->sync_group_setting;
+	if (!lf->sync_group.empty())
+		sync_join(lf->sync_group);
+	// Joining a running group takes its speed; only a later change of this
+	// member's setting is passed on to the others
+	lf->sync_speed_seen = lf->playback_speed;
+}
+
+// Advance the member's group clock, once per video frame across the group,
+// and copy it into the member's loop clock. An idle group starts again from
+// this member's own position. Returns false if the member isn't in a group.
+static bool sync_advance_locked(loop_filter *lf, double seconds)
+{
+	if (lf->sync_group.empty())
+		return false;
+
+	uint64_t now = obs_get_video_frame_time();
+	std::lock_guard<std::mutex> lk(module_sync.mtx);
+	sync_group *g = sync_find_locked(lf->sync_group);
+	if (!g)
+		return false;
+
+	if (g->ticked_at == 0 || now < g->ticked_at || now - g->ticked_at > LOOPER_SYNC_IDLE_NS) {
+		g->phase = lf->loop_phase;
+		g->clock = lf->loop_clock;
+		g->speed = lf->playback_speed;
+		g->direction = lf->direction;
+		g->ticked_at = 0;
+		lf->sync_speed_seen = lf->playback_speed;
+	}
+
+	// A member whose speed setting changed sets the speed for all of them
+	if (lf->playback_speed != lf->sync_speed_seen) {
+		g->speed = lf->playback_speed;
+		lf->sync_speed_seen = lf->playback_speed;
+	}
+
+	if (g->ticked_at != now) {
+		g->clock += seconds * 1000000000.0 * g->speed;
+		g->ticked_at = now;
+	}
+
+	lf->loop_phase = g->phase;
+	lf->loop_clock = g->clock;
+	if (!lf->ping_pong)
+		lf->direction = g->direction;
+	return true;
+}
+
+// ----------------------------- Helpers -----------------------------
+
+// Add the result of query slot 'i' to the running average, dropping it if the
+// GPU hasn't finished or the clock was disjoint (a power state change)
+static void gpu_timer_collect(gpu_pass_timer *t, size_t i)
+{
+	t->pending[i] = false;
+	bool disjoint = true;
+	uint64_t frequency = 0, ticks = 0;
+	if (!gs_timer_range_get_data(t->ranges[i], &disjoint, &frequency) || disjoint || frequency == 0 ||
+	    !gs_timer_get_data(t->timers[i], &ticks))
+		return;
+
+	t->total_ns += (uint64_t)(ticks * (1000000000.0 / (double)frequency));
+	if (++t->samples < LOOPER_GPU_TIMER_LOG)
+		return;
+	blog(LOG_INFO, "[" PLUGIN_ID "] GPU time per %s pass: %.3f ms (average of %llu)", t->name,
+	     t->total_ns / 1000000.0 / t->samples, (unsigned long long)t->samples);
+	t->total_ns = 0;
+	t->samples = 0;
+}
+
+static void gpu_timer_begin(gpu_pass_timer *t)
+{
+	size_t i = t->next;
+	if (t->pending[i])
+		gpu_timer_collect(t, i);
+	if (!t->ranges[i])
+		t->ranges[i] = gs_timer_range_create();
+	if (!t->timers[i])
+		t->timers[i] = gs_timer_create();
+	if (!t->ranges[i] || !t->timers[i])
+		return;
+
+	gs_timer_range_begin(t->ranges[i]);
+	gs_timer_begin(t->timers[i]);
+	t->active = true;
+}
+
+static void gpu_timer_end(gpu_pass_timer *t)
+{
+	if (!t->active)
+		return;
+	size_t i = t->next;
+	gs_timer_end(t->timers[i]);
+	gs_timer_range_end(t->ranges[i]);
+	t->pending[i] = true;
+	t->active = false;
+	t->next = (i + 1) % LOOPER_GPU_TIMER_DEPTH;
+}
+
+static void gpu_timer_destroy(gpu_pass_timer *t)
+{
+	for (size_t i = 0; i < LOOPER_GPU_TIMER_DEPTH; ++i) {
+		if (t->timers[i])
+			gs_timer_destroy(t->timers[i]);
+		if (t->ranges[i])
+			gs_timer_range_destroy(t->ranges[i]);
+		t->timers[i] = nullptr;
+		t->ranges[i] = nullptr;
+		t->pending[i] = false;
+	}
+	t->active = false;
+}
+
+// Times the GPU work of a render pass for as long as it is in scope
+struct gpu_timer_scope {
+	gpu_pass_timer *timer;
+	explicit gpu_timer_scope(gpu_pass_timer *t) : timer(t) { gpu_timer_begin(timer); }
+	~gpu_timer_scope() { gpu_timer_end(timer); }
+};
+
+// Frames live in up to three tiers, always ordered by age: the oldest frames in
+// host memory (system RAM or the disk cache), then frames whose readback is
+// still in flight, then the newest frames as render targets. Logical index 0 is
+// the oldest buffered frame. Async sources instead keep their raw frames in a
+// fourth tier of their own, with the other three left empty.
+
+static inline void update_frame_count_locked(loop_filter *lf)
+{
+	lf->frame_count = lf->host.count + lf->readback.count + lf->vram.count + lf->async_frames.count;
+
+	// Frames only ever leave from the front, except for failed readbacks which
+	// erase their own metadata row
+	while (lf->meta.count > lf->frame_count)
+		lf->meta.pop();
+}
+
+// Buffered frames moved, so the uploaded host frames no longer match their indices
+static inline void forget_uploads_locked(loop_filter *lf)
+{
+	lf->upload_index = SIZE_MAX;
+	lf->blend_upload_index = SIZE_MAX;
+}
+
+// Row layout of one frame's storage texture, as copied to and from host memory
+static inline void storage_frame_layout(const loop_filter *lf, uint32_t *cx, uint32_t *cy, size_t *row_bytes)
+{
+	storage_texture_size(lf->ring_storage, lf->base_w, lf->base_h, cx, cy);
+	*row_bytes = (size_t)*cx * storage_texel_bytes(lf->ring_storage);
+}
+
+// Memory holding a host-tier frame of 'bytes' bytes, or nullptr if it can't hold
+// one that size. RAM buffers are only allocated once a frame is written to them.
+// Compressed frames only have raw data until a worker has encoded them.
+static uint8_t *host_frame_data(loop_filter *lf, host_frame &frame, size_t bytes, bool write)
+{
+	if (lf->host_kind == OVERFLOW_DISK) {
+		if (!lf->disk.data || bytes > lf->disk_frame_bytes)
+			return nullptr;
+		return lf->disk.data + frame.offset;
+	}
+
+	if (overflow_is_coded(lf->host_kind)) {
+		if (write) {
+			if (!lf->raw_pool.empty()) {
+				frame.raw = std::move(lf->raw_pool.back());
+				lf->raw_pool.pop_back();
+			} else {
+				frame.raw = std::make_shared<std::vector<uint8_t>>();
+			}
+			frame.raw->resize(bytes);
+			frame.packed.reset();
+			lf->host_bytes += bytes;
+		}
+		return frame.raw && frame.raw->size() >= bytes ? frame.raw->data() : nullptr;
+	}
+
+	if (write)
+		frame.ram.resize(bytes);
+	return frame.ram.size() >= bytes ? frame.ram.data() : nullptr;
+}
+
+// Keep a raw buffer for the next compressed frame, unless a worker still has it
+static void recycle_raw_buffer_locked(loop_filter *lf, frame_buffer &raw)
+{
+	if (raw && raw.use_count() == 1 && lf->raw_pool.size() < LOOPER_READBACK_DEPTH * 2)
+		lf->raw_pool.push_back(std::move(raw));
+	raw.reset();
+}
+
+// Compressed frames give their memory back when they leave the host tier
+static void release_host_frame_locked(loop_filter *lf, host_frame &frame)
+{
+	if (overflow_is_coded(lf->host_kind)) {
+		lf->host_bytes -= frame.raw ? frame.raw->size() : 0;
+		lf->host_bytes -= frame.packed ? frame.packed->size() : 0;
+		recycle_raw_buffer_locked(lf, frame.raw);
+		frame.packed.reset();
+	}
+}
+
+// Drop the oldest host frame
+static void pop_host_locked(loop_filter *lf)
+{
+	release_host_frame_locked(lf, lf->host.at(0));
+	lf->host.pop();
+}
+
+// Host-tier index of the frame with sequence number 'seq', or SIZE_MAX. Host
+// frames get increasing sequence numbers and normally only leave from the
+// front; thinning leaves gaps, which the binary search covers.
+static size_t host_index_of_seq_locked(loop_filter *lf, uint64_t seq)
+{
+	if (lf->host.count == 0 || seq < lf->host.at(0).seq)
+		return SIZE_MAX;
+	uint64_t offset = seq - lf->host.at(0).seq;
+	if (offset < lf->host.count && lf->host.at((size_t)offset).seq == seq)
+		return (size_t)offset;
+
+	size_t lo = 0, hi = lf->host.count;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (lf->host.at(mid).seq < seq)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo < lf->host.count && lf->host.at(lo).seq == seq ? lo : SIZE_MAX;
+}
+
+// Encoded frames can only be decoded from their GOP's keyframe, so frames left
+// at the front without one go too. Returns the number of frames dropped.
+static size_t trim_partial_gop_locked(loop_filter *lf)
+{
+	size_t dropped = 0;
+	while (lf->host_kind == OVERFLOW_ENCODED && lf->host.count > 0 && lf->host.at(0).packed &&
+	       !lf->host.at(0).keyframe) {
+		pop_host_locked(lf);
+		dropped++;
+	}
+	return dropped;
+}
+
+static void clear_host_locked(loop_filter *lf)
+{
+	while (lf->host.count > 0)
+		pop_host_locked(lf);
+	lf->host.clear();
+}
+
+static void format_codec_stats(const codec_stats &stats, char *text, size_t size)
+{
+	double ratio = stats.packed_bytes ? (double)stats.raw_bytes / (double)stats.packed_bytes : 0.0;
+	double encode_ms = stats.encoded ? stats.encode_ns / 1000000.0 / stats.encoded : 0.0;
+	double decode_ms = stats.decoded ? stats.decode_ns / 1000000.0 / stats.decoded : 0.0;
+	snprintf(text, size, "%.1fx smaller, encode %.2f ms/frame, decode %.2f ms/frame", ratio, encode_ms, decode_ms);
+}
+
+// Swap raw frames for their compressed versions as the workers finish them
+static void collect_encoded_locked(loop_filter *lf)
+{
+	if (!overflow_is_coded(lf->host_kind))
+		return;
+
+	std::vector<codec_result> done;
+	codec_stats stats;
+	{
+		std::lock_guard<std::mutex> lk(lf->codec.mtx);
+		done.swap(lf->codec.done);
+		stats = lf->codec.stats;
+	}
+
+	for (auto &result : done) {
+		size_t index = host_index_of_seq_locked(lf, result.seq);
+		if (index != SIZE_MAX) {
+			// Frames that failed to encode stay raw
+			host_frame &frame = lf->host.at(index);
+			if (result.packed && frame.raw == result.raw) {
+				lf->host_bytes -= frame.raw->size();
+				lf->host_bytes += result.packed->size();
+				frame.packed = std::move(result.packed);
+				frame.keyframe = result.keyframe;
+				frame.raw.reset();
+			}
+		}
+		recycle_raw_buffer_locked(lf, result.raw);
+	}
+
+	if (stats.encoded >= lf->codec_reported + 300) {
+		char text[128];
+		format_codec_stats(stats, text, sizeof(text));
+		blog(LOG_INFO, "[" PLUGIN_ID "] %s RAM tier: %zu frames in %zuMB, %s",
+		     lf->host_kind == OVERFLOW_ENCODED ? "H.264" : "Compressed", lf->host.count,
+		     lf->host_bytes / (1024 * 1024), text);
+		lf->codec_reported = stats.encoded;
+	}
+}
+
+// Decoded pixels of a compressed host frame: from the decode-ahead cache if a
+// worker got to it in time, otherwise decoded here on the render thread.
+// Encoded frames need their whole GOP, so they only come from the cache.
+static frame_buffer decoded_frame_locked(loop_filter *lf, const host_frame &frame, size_t bytes)
+{
+	{
+		std::lock_guard<std::mutex> lk(lf->codec.mtx);
+		for (auto &entry : lf->codec.cache) {
+			if (entry.seq == frame.seq && entry.ready && entry.pixels->size() >= bytes)
+				return entry.pixels;
+		}
+	}
+	if (lf->host_kind == OVERFLOW_ENCODED)
+		return nullptr;
+
+	if (!lf->decode_scratch)
+		lf->decode_scratch = std::make_shared<std::vector<uint8_t>>();
+	lf->decode_scratch->resize(bytes);
+
+	uint64_t start = os_gettime_ns();
+	if (!qoi_decode(frame.packed->data(), frame.packed->size(), lf->decode_scratch->data(), bytes)) {
+		blog(LOG_WARNING, "[" PLUGIN_ID "] Could not decode compressed frame %llu",
+		     (unsigned long long)frame.seq);
+		return nullptr;
+	}
+
+	std::lock_guard<std::mutex> lk(lf->codec.mtx);
+	lf->codec.stats.decoded++;
+	lf->codec.stats.decode_ns += os_gettime_ns() - start;
+	return lf->decode_scratch;
+}
+
+// Drop logical frame 'index', which failed to move between tiers
+static void drop_frame_locked(loop_filter *lf, size_t index, const char *reason)
+{
+	blog(LOG_WARNING, "[" PLUGIN_ID "] %s, frame dropped from the %s tier", reason,
+	     lf->host_kind == OVERFLOW_DISK ? "disk" : "RAM");
+	if (index < lf->meta.count)
+		lf->meta.erase(index);
+	update_frame_count_locked(lf);
+}
+
+// Copy the oldest in-flight readback into the host tier. Blocks only if the
+// GPU hasn't finished the copy yet, which after a few frames it normally has.
+static void complete_readback_locked(loop_filter *lf)
+{
+	gs_stagesurf_t *stage = lf->readback.at(0);
+	lf->readback.pop();
+
+	uint32_t cx, cy;
+	size_t row_bytes;
+	storage_frame_layout(lf, &cx, &cy, &row_bytes);
+
+	// Disk slots are sized for the frame size the cache was created with
+	size_t frame_bytes = row_bytes * cy;
+	if (lf->host_kind == OVERFLOW_DISK && frame_bytes > lf->disk_frame_bytes) {
+		drop_frame_locked(lf, lf->host.count, "Frame does not fit the disk cache");
+		return;
+	}
+
+	uint8_t *data = nullptr;
+	uint32_t linesize = 0;
+	if (lf->host.capacity() == 0 || !stage || gs_stagesurface_get_width(stage) != cx ||
+	    gs_stagesurface_get_height(stage) != cy || !gs_stagesurface_map(stage, &data, &linesize)) {
+		drop_frame_locked(lf, lf->host.count, "Readback failed");
+		return;
+	}
+
+	// Oldest host frame makes room when the tier is full
+	if (lf->host.full())
+		pop_host_locked(lf);
+
+	// Coded tiers are limited by bytes rather than frames, so content that
+	// compresses well gets a longer buffer
+	if (overflow_is_coded(lf->host_kind)) {
+		size_t limit = lf->max_ram_mb * 1024 * 1024;
+		if (lf->host.count > 0 && lf->host_bytes + frame_bytes > limit && !lf->ram_limit_logged) {
+			blog(LOG_INFO, "[" PLUGIN_ID "] RAM limit reached: compressed tier holds %zu frames in %zuMB",
+			     lf->host.count, lf->host_bytes / (1024 * 1024));
+			lf->ram_limit_logged = true;
+		}
+		while (lf->host.count > 0 && lf->host_bytes + frame_bytes > limit)
+			pop_host_locked(lf);
+	}
+	trim_partial_gop_locked(lf);
+
+	host_frame &frame = lf->host.next();
+	uint8_t *dst = host_frame_data(lf, frame, frame_bytes, true);
+	for (uint32_t y = 0; y < cy; ++y)
+		memcpy(dst + y * row_bytes, data + (size_t)y * linesize, row_bytes);
+	gs_stagesurface_unmap(stage);
+
+	lf->host.push();
+	update_frame_count_locked(lf);
+
+	if (overflow_is_coded(lf->host_kind)) {
+		frame.seq = lf->next_seq++;
+		frame.keyframe = false;
+		codec_job job;
+		job.seq = frame.seq;
+		job.in = frame.raw;
+		job.width = cx;
+		job.height = lf->base_h;
+		codec_submit(&lf->codec, std::move(job));
+	}
+}
+
+static void flush_readbacks_locked(loop_filter *lf)
+{
+	while (lf->readback.count > 0)
+		complete_readback_locked(lf);
+}
+
+// Move the oldest VRAM frame to host memory. The copy into a staging surface is
+// queued on the GPU now and only mapped LOOPER_READBACK_DEPTH captures later,
+// so recording never waits on the GPU. The freed render target is reused by
+// the next capture; GPU command order keeps the pending copy intact.
+static void demote_oldest_locked(loop_filter *lf)
+{
+	if (lf->readback.full())
+		complete_readback_locked(lf);
+
+	gs_texrender_t *oldest = lf->vram.at(0);
+	gs_texture_t *tex = oldest ? gs_texrender_get_texture(oldest) : nullptr;
+	lf->vram.pop();
+
+	uint32_t cx, cy;
+	size_t row_bytes;
+	storage_frame_layout(lf, &cx, &cy, &row_bytes);
+
+	gs_stagesurf_t *&stage = lf->readback.next();
+	if (stage && (gs_stagesurface_get_width(stage) != cx || gs_stagesurface_get_height(stage) != cy)) {
+		gs_stagesurface_destroy(stage);
+		stage = nullptr;
+	}
+	if (!stage)
+		stage = gs_stagesurface_create(cx, cy, storage_color_format(lf->ring_storage));
+
+	if (!stage || !tex) {
+		drop_frame_locked(lf, lf->host.count + lf->readback.count, "Could not stage frame");
+		return;
+	}
+
+	gs_stage_texture(stage, tex);
+	lf->readback.push();
+	update_frame_count_locked(lf);
+}
+
+// Upload host frame 'index' into the dynamic texture 'tex' unless it already
+// holds it. Returns nullptr if the frame's data isn't available.
+static gs_texture_t *upload_host_frame_locked(loop_filter *lf, size_t index, gs_texture_t *&tex, size_t &held)
+{
+	uint32_t cx, cy;
+	size_t row_bytes;
+	storage_frame_layout(lf, &cx, &cy, &row_bytes);
+
+	if (tex && (gs_texture_get_width(tex) != cx || gs_texture_get_height(tex) != cy ||
+		    gs_texture_get_color_format(tex) != storage_color_format(lf->ring_storage))) {
+		gs_texture_destroy(tex);
+		tex = nullptr;
+	}
+	if (!tex) {
+		tex = gs_texture_create(cx, cy, storage_color_format(lf->ring_storage), 1, nullptr, GS_DYNAMIC);
+		held = SIZE_MAX;
+	}
+	if (!tex)
+		return nullptr;
+
+	// Playback often holds a frame for several ticks, so only upload on change
+	if (held == index)
+		return tex;
+
+	// Disk frames are read straight out of the mapping, faulting in if the
+	// prefetch hasn't brought them in yet. 'decoded' keeps a decompressed
+	// frame alive until it is uploaded.
+	host_frame &frame = lf->host.at(index);
+	frame_buffer decoded;
+	const uint8_t *data = host_frame_data(lf, frame, row_bytes * cy, false);
+	if (!data && frame.packed) {
+		decoded = decoded_frame_locked(lf, frame, row_bytes * cy);
+		data = decoded ? decoded->data() : nullptr;
+	}
+	if (!data)
+		return nullptr;
+
+	gs_texture_set_image(tex, data, (uint32_t)row_bytes, false);
+	held = index;
+	return tex;
+}
+
+// Texture for logical frame 'index', or with 'blend' for the frame blended into
+// it. Host-tier frames are uploaded into one of two reusable dynamic textures;
+// in-flight readbacks are not drawable.
+static gs_texture_t *frame_texture_locked(loop_filter *lf, size_t index, bool blend)
+{
+	if (index >= lf->frame_count)
+		return nullptr;
+
+	if (index >= lf->host.count + lf->readback.count) {
+		gs_texrender_t *tr = lf->vram.at(index - lf->host.count - lf->readback.count);
+		return tr ? gs_texrender_get_texture(tr) : nullptr;
+	}
+
+	if (index >= lf->host.count)
+		return nullptr;
+
+	if (blend)
+		return upload_host_frame_locked(lf, index, lf->blend_tex, lf->blend_upload_index);
+
+	// The cursor usually moves on to the frame it was blending in, already uploaded
+	if (lf->upload_index != index && lf->blend_upload_index == index) {
+		std::swap(lf->upload_tex, lf->blend_tex);
+		std::swap(lf->upload_index, lf->blend_upload_index);
+	}
+	gs_texture_t *tex = upload_host_frame_locked(lf, index, lf->upload_tex, lf->upload_index);
+
+	// Keep showing the last frame while its GOP is still being decoded
+	if (!tex && lf->upload_index != SIZE_MAX)
+		return lf->upload_tex;
+	return tex;
+}
+
+// Queue decodes for the compressed frames from the cursor onwards, reusing
+// cache entries the cursor has moved away from
+static void request_decodes_locked(loop_filter *lf)
+{
+	uint32_t cx, cy;
+	size_t row_bytes;
+	storage_frame_layout(lf, &cx, &cy, &row_bytes);
+
+	uint64_t wanted[LOOPER_DECODE_AHEAD + 1];
+	const frame_buffer *packed[LOOPER_DECODE_AHEAD + 1];
+	size_t wanted_count = 0;
+	size_t index = lf->play_index;
+	for (int i = 0; i <= LOOPER_DECODE_AHEAD && index < lf->host.count; ++i) {
+		host_frame &frame = lf->host.at(index);
+		if (frame.packed) {
+			wanted[wanted_count] = frame.seq;
+			packed[wanted_count++] = &frame.packed;
+		}
+		if (lf->direction < 0 && index == 0)
+			break;
+		index = lf->direction > 0 ? index + 1 : index - 1;
+	}
+
+	auto is_wanted = [&](uint64_t seq) {
+		for (size_t i = 0; i < wanted_count; ++i) {
+			if (wanted[i] == seq)
+				return true;
+		}
+		return false;
+	};
+
+	bool queued = false;
+	{
+		std::lock_guard<std::mutex> lk(lf->codec.mtx);
+		for (size_t i = 0; i < wanted_count; ++i) {
+			decoded_frame *victim = nullptr;
+			bool cached = false;
+			for (auto &entry : lf->codec.cache) {
+				if (entry.seq == wanted[i]) {
+					cached = true;
+					break;
+				}
+				if (!victim && !is_wanted(entry.seq))
+					victim = &entry;
+			}
+			if (cached)
+				continue;
+			if (!victim)
+				break;
+
+			codec_job job;
+			job.decode = true;
+			job.seq = wanted[i];
+			job.in = *packed[i];
+			job.raw_bytes = row_bytes * cy;
+			if (victim->pixels && victim->pixels.use_count() == 1)
+				job.out = std::move(victim->pixels);
+			victim->pixels.reset();
+			victim->seq = wanted[i];
+			victim->ready = false;
+			lf->codec.jobs.push_back(std::move(job));
+			queued = true;
+		}
+	}
+	if (queued)
+		lf->codec.cv.notify_all();
+}
+
+// Host index range [*first, *end) of the encoded GOP holding 'index', up to
+// the first frame not encoded yet. False if it has no keyframe to start from.
+static bool gop_range_locked(loop_filter *lf, size_t index, size_t *first, size_t *end)
+{
+	size_t start = index;
+	while (start > 0 && !lf->host.at(start).keyframe)
+		start--;
+	if (!lf->host.at(start).packed || !lf->host.at(start).keyframe)
+		return false;
+
+	size_t stop = start + 1;
+	while (stop < lf->host.count && lf->host.at(stop).packed && !lf->host.at(stop).keyframe)
+		stop++;
+	if (index >= stop)
+		return false;
+
+	*first = start;
+	*end = stop;
+	return true;
+}
+
+// Queue whole-GOP decodes for the cursor's GOP and the one it is heading into.
+// Decoded GOPs stay cached around the cursor, so reversing direction mid-GOP
+// (ping-pong) plays from the cache instead of decoding again.
+static void request_gop_decodes_locked(loop_filter *lf)
+{
+	if (lf->play_index >= lf->host.count)
+		return;
+
+	uint32_t cx, cy;
+	size_t row_bytes;
+	storage_frame_layout(lf, &cx, &cy, &row_bytes);
+
+	// Sequence range of the cursor's GOP, which is never evicted
+	size_t cursor_first = 0, cursor_end = 0;
+	uint64_t keep_first = UINT64_MAX, keep_end = UINT64_MAX;
+	if (gop_range_locked(lf, lf->play_index, &cursor_first, &cursor_end)) {
+		keep_first = lf->host.at(cursor_first).seq;
+		keep_end = keep_first + (cursor_end - cursor_first);
+	}
+
+	size_t ahead;
+	if (lf->direction > 0)
+		ahead = std::min(lf->play_index + LOOPER_DECODE_AHEAD, lf->host.count - 1);
+	else
+		ahead = lf->play_index > LOOPER_DECODE_AHEAD ? lf->play_index - LOOPER_DECODE_AHEAD : 0;
+
+	uint64_t cursor_seq = lf->host.at(lf->play_index).seq;
+	bool queued = false;
+	{
+		std::lock_guard<std::mutex> lk(lf->codec.mtx);
+		for (size_t target : {lf->play_index, ahead}) {
+			size_t first, end;
+			if (!gop_range_locked(lf, target, &first, &end))
+				continue;
+
+			uint64_t target_seq = lf->host.at(target).seq;
+			uint64_t first_seq = lf->host.at(first).seq;
+			uint64_t end_seq = first_seq + (end - first);
+			bool cached = false;
+			for (auto &entry : lf->codec.cache) {
+				if (entry.seq == target_seq) {
+					cached = true;
+					break;
+				}
+			}
+			if (cached)
+				continue;
+
+			// Reuse the entries furthest from the cursor, outside both GOPs
+			std::vector<decoded_frame *> victims;
+			for (auto &entry : lf->codec.cache) {
+				bool in_gop = entry.seq >= first_seq && entry.seq < end_seq;
+				bool in_cursor_gop = entry.seq >= keep_first && entry.seq < keep_end;
+				if (!in_gop && !in_cursor_gop)
+					victims.push_back(&entry);
+			}
+			if (victims.size() < end - first)
+				continue;
+
+			auto distance = [cursor_seq](const decoded_frame *entry) {
+				if (entry->seq == UINT64_MAX)
+					return UINT64_MAX;
+				return entry->seq > cursor_seq ? entry->seq - cursor_seq : cursor_seq - entry->seq;
+			};
+			std::sort(victims.begin(), victims.end(), [&](const decoded_frame *a, const decoded_frame *b) {
+				return distance(a) > distance(b);
+			});
+
+			// Any earlier entries for this GOP are replaced by the new decode
+			for (auto &entry : lf->codec.cache) {
+				if (entry.seq >= first_seq && entry.seq < end_seq)
+					entry = decoded_frame();
+			}
+
+			codec_job job;
+			job.decode = true;
+			job.seq = first_seq;
+			job.raw_bytes = row_bytes * cy;
+			job.width = cx;
+			job.height = lf->base_h;
+			for (size_t i = first; i < end; ++i) {
+				decoded_frame *victim = victims[i - first];
+				job.packets.push_back(lf->host.at(i).packed);
+				job.outs.push_back(victim->pixels && victim->pixels.use_count() == 1
+							   ? std::move(victim->pixels)
+							   : nullptr);
+				victim->pixels.reset();
+				victim->seq = lf->host.at(i).seq;
+				victim->ready = false;
+			}
+			lf->codec.jobs.push_back(std::move(job));
+			queued = true;
+		}
+	}
+	if (queued)
+		lf->codec.cv.notify_all();
+}
+
+// Get the host frames the cursor will reach next ready ahead of time: disk
+// frames are paged in, compressed frames decoded by the workers
+static void prefetch_host_frames_locked(loop_filter *lf)
+{
+	if (lf->host.count == 0)
+		return;
+
+	if (lf->host_kind == OVERFLOW_COMPRESSED) {
+		request_decodes_locked(lf);
+		return;
+	}
+	if (lf->host_kind == OVERFLOW_ENCODED) {
+		request_gop_decodes_locked(lf);
+		return;
+	}
+	if (lf->host_kind != OVERFLOW_DISK)
+		return;
+
+	// A cursor in the readback or VRAM tiers reaches the newest host frames
+	// first when heading back, and none when heading forward
+	size_t index = lf->play_index < lf->host.count ? lf->play_index : lf->host.count;
+	for (int i = 0; i < LOOPER_PREFETCH_FRAMES; ++i) {
+		if (lf->direction > 0 ? index + 1 >= lf->host.count : index == 0)
+			break;
+		index += lf->direction;
+		mapped_file_prefetch(&lf->disk, lf->host.at(index).offset, lf->disk_frame_bytes);
+	}
+}
+
+// The VRAM ring holds one slot more than its frame limit. That spare slot is
+// always free: captures render the parent straight into it, and committing the
+// capture frees the oldest frame's slot (or demotes it to RAM) as the next spare.
+static inline gs_texrender_t *ring_next_slot_locked(loop_filter *lf)
+{
+	if (lf->vram.capacity() == 0 || lf->vram.full())
+		return nullptr;
+	gs_texrender_t *slot = lf->vram.next();
+	// Reused slots keep their texture but must be reset before they can be rendered again
+	if (slot)
+		gs_texrender_reset(slot);
+	return slot;
+}
+
+// Time between captures in ns
+static inline uint64_t capture_interval_ns(const loop_filter *lf)
+{
+	return (uint64_t)(1000000000.0 * lf->capture_skip_frames * lf->capture_stretch / lf->fps);
+}
+
+// Add the metadata row of a new newest frame. Returns its capture number.
+static uint64_t push_meta_locked(loop_filter *lf, uint64_t timestamp)
+{
+	uint64_t nominal = capture_interval_ns(lf);
+
+	// The previous newest frame was on screen until now. Source clocks can jump
+	// back, e.g. when a media file restarts, so fall back to the nominal interval.
+	if (lf->meta.count > 0) {
+		size_t prev = lf->meta.slot(lf->meta.count - 1);
+		uint64_t prev_time = lf->meta.timestamp[prev];
+		lf->meta.duration[prev] = timestamp > prev_time ? timestamp - prev_time : nominal;
+	}
+	uint64_t serial = lf->capture_serial++;
+	if (!lf->meta.full())
+		lf->meta.push(timestamp, nominal, serial);
+	return serial;
+}
+
+// Keep the capture in the ring's spare slot as the newest frame. Returns its capture number.
+static uint64_t ring_commit_locked(loop_filter *lf, uint64_t timestamp)
+{
+	uint64_t serial = push_meta_locked(lf, timestamp);
+
+	lf->vram.push();
+	if (lf->vram.count > lf->vram_frames) {
+		if (lf->host_frames > 0)
+			demote_oldest_locked(lf);
+		else
+			lf->vram.pop();
+	}
+	forget_uploads_locked(lf);
+	update_frame_count_locked(lf);
+	return serial;
+}
+
+// Seconds of content in the buffer: the sum of the frames' display durations
+static double buffered_seconds_locked(loop_filter *lf)
+{
+	if (lf->meta.count == 0)
+		return lf->frame_count * capture_interval_ns(lf) / 1000000000.0;
+	return lf->meta.length() / 1000000000.0;
+}
+
+// Playback runs on the content clock: the time since the oldest frame was
+// captured, as recorded in the metadata rows. Without a row for every frame
+// the frames are taken to be evenly spaced.
+static inline bool meta_aligned_locked(const loop_filter *lf)
+{
+	return lf->meta.count == lf->frame_count && lf->frame_count > 0;
+}
+
+static double frame_offset_ns_locked(const loop_filter *lf, size_t index)
+{
+	if (meta_aligned_locked(lf))
+		return (double)lf->meta.offset(index);
+	return (double)index * capture_interval_ns(lf);
+}
+
+static double content_length_ns_locked(const loop_filter *lf)
+{
+	if (meta_aligned_locked(lf))
+		return (double)lf->meta.length();
+	return (double)lf->frame_count * capture_interval_ns(lf);
+}
+
+// Frame on screen at content time 'position'
+static size_t frame_at_time_locked(const loop_filter *lf, double position)
+{
+	if (lf->frame_count == 0 || position <= 0.0)
+		return 0;
+	size_t index;
+	if (meta_aligned_locked(lf)) {
+		index = lf->meta.row_at((uint64_t)position);
+	} else {
+		uint64_t interval = capture_interval_ns(lf);
+		index = interval > 0 ? (size_t)(position / interval) : 0;
+	}
+	return index < lf->frame_count ? index : lf->frame_count - 1;
+}
+
+// The cursor is a pure function of the loop clock, the content time played
+// since it was last placed: a sawtooth over the content length for forward
+// loops, a triangle wave between the first and newest frames' capture times
+// for ping-pong. Any speed costs the same, and a given clock value always
+// gives the same position.
+struct cursor_shape {
+	double start;  // Content time of the first frame played
+	double span;   // Content time covered between turns or wraps
+	double half;   // Clock time between turns or wraps, longer than span when eased
+	double period; // Clock time of one whole cycle
+	double fade;   // Forward loops: content time crossfaded over the wrap
+	double ease;   // Ping-pong: clock time of each eased ramp into and out of a turn
+	bool ping_pong;
+};
+
+// Frames a forward loop plays, [*first, *end). The range found by
+// find_loop_points_locked() until the buffer changes under it.
+static void loop_range_locked(const loop_filter *lf, size_t *first, size_t *end)
+{
+	bool valid = !lf->ping_pong && lf->loop_end > 0 && lf->loop_end <= lf->frame_count &&
+		     lf->loop_first < lf->loop_end;
+	*first = valid ? lf->loop_first : 0;
+	*end = valid ? lf->loop_end : lf->frame_count;
+}
+
+// Content time of the crossfade window: the first crossfade_frames frames of
+// the loop range [first, end), at most half of it. Async frames are handed to
+// the source unblended, so they never crossfade.
+static double crossfade_ns_locked(const loop_filter *lf, size_t first, size_t end)
+{
+	size_t n = (size_t)lf->crossfade_frames;
+	if (n > (end - first) / 2)
+		n = (end - first) / 2;
+	if (n == 0 || lf->async_mode)
+		return 0.0;
+	return frame_offset_ns_locked(lf, first + n) - frame_offset_ns_locked(lf, first);
+}
+
+// A forward loop with a crossfade starts 'fade' into its range and ends at the
+// range's end, mixing its last 'fade' of content with the range's first. The
+// wrap then lands on the frame the mix already ended on.
+static cursor_shape cursor_shape_locked(const loop_filter *lf)
+{
+	cursor_shape shape;
+	shape.ping_pong = lf->ping_pong;
+	shape.fade = 0.0;
+	shape.ease = 0.0;
+	if (lf->ping_pong) {
+		shape.start = 0.0;
+		shape.span = frame_offset_ns_locked(lf, lf->frame_count - 1);
+		shape.ease = clampv(lf->ease_seconds * 1000000000.0, 0.0, shape.span);
+		shape.half = shape.span + shape.ease;
+		shape.period = shape.half * 2.0;
+		return shape;
+	}
+	size_t first, end;
+	loop_range_locked(lf, &first, &end);
+	double stop = end < lf->frame_count ? frame_offset_ns_locked(lf, end) : content_length_ns_locked(lf);
+	shape.fade = crossfade_ns_locked(lf, first, end);
+	shape.start = frame_offset_ns_locked(lf, first) + shape.fade;
+	shape.span = stop - shape.start;
+	shape.half = shape.span;
+	shape.period = shape.half;
+	return shape;
+}
+
+// Content covered by an eased ramp 'x' into it, for a ramp of clock time 'a'.
+// Speed follows a raised cosine from 0 to full, so the ramp covers a / 2.
+static double eased_ramp(double a, double x)
+{
+	const double pi = 3.14159265358979323846;
+	return x / 2.0 - a / (2.0 * pi) * std::sin(pi * x / a);
+}
+
+// Content covered 's' of clock time into a ping-pong leg. Eased legs ramp up
+// over their first 'ease' and down over their last, at full speed between, so
+// the cursor stops smoothly at each turn instead of flipping direction.
+static double leg_position(const cursor_shape &shape, double s)
+{
+	double a = shape.ease;
+	if (a <= 0.0)
+		return s;
+	if (s < a)
+		return eased_ramp(a, s);
+	if (s > shape.half - a)
+		return shape.span - eased_ramp(a, shape.half - s);
+	return s - a / 2.0;
+}
+
+// Clock time into a ping-pong leg at which it covers content 'p', the inverse
+// of leg_position(). Ramps are found by bisection; this only runs when the
+// cursor is placed.
+static double leg_phase(const cursor_shape &shape, double p)
+{
+	double a = shape.ease;
+	if (a <= 0.0)
+		return p;
+	if (p >= a / 2.0 && p <= shape.span - a / 2.0)
+		return p + a / 2.0;
+
+	bool tail = p > shape.span - a / 2.0;
+	double target = clampv(tail ? shape.span - p : p, 0.0, a / 2.0);
+	double lo = 0.0, hi = a;
+	for (int i = 0; i < 48; ++i) {
+		double mid = (lo + hi) / 2.0;
+		if (eased_ramp(a, mid) < target)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	double x = (lo + hi) / 2.0;
+	return tail ? shape.half - x : x;
+}
+
+// Position and direction at loop clock phase 'phase'
+static double cursor_position(const cursor_shape &shape, int reverse, double phase, int *direction)
+{
+	double m = std::fmod(phase, shape.period);
+	if (m < 0.0)
+		m += shape.period;
+	if (shape.ping_pong) {
+		*direction = m < shape.half ? +1 : -1;
+		return shape.start + leg_position(shape, m <= shape.half ? m : shape.period - m);
+	}
+	*direction = reverse;
+	return shape.start + (reverse > 0 ? m : shape.period - m);
+}
+
+// Place the cursor at content time 'position', heading in lf->direction
+static void place_cursor_locked(loop_filter *lf, double position)
+{
+	cursor_shape shape = cursor_shape_locked(lf);
+	lf->play_time = position;
+	lf->loop_clock = 0.0;
+	lf->loop_phase = position - shape.start;
+	if (shape.ping_pong)
+		lf->loop_phase = leg_phase(shape, clampv(lf->loop_phase, 0.0, shape.span));
+	if (lf->direction < 0)
+		lf->loop_phase = shape.period - lf->loop_phase;
+	lf->loop_shape_period = shape.period;
+	lf->loop_shape_ping_pong = shape.ping_pong;
+	lf->loops_placed = lf->total_loops;
+}
+
+// Shortest loop seamless loop points may cut the buffer down to: half the
+// configured buffer length, so most of it still plays, and never less than
+// LOOPER_LOOP_MIN_NS. Candidates are matched over the same span they are
+// chosen by, so a row's best match is always one the loop can use.
+static uint64_t loop_min_span_ns(const loop_filter *lf)
+{
+	uint64_t half = (uint64_t)lf->buffer_seconds * 1000000000ull / 2;
+	return half > LOOPER_LOOP_MIN_NS ? half : LOOPER_LOOP_MIN_NS;
+}
+
+// Choose the frames a forward loop runs between: the measured pair with the
+// most similar thumbnails, at least loop_min_span_ns() apart. Frame
+// loop_end - 1 then wraps to loop_first, which looks like the frame that
+// followed it. Without a match the whole buffer loops.
+static void find_loop_points_locked(loop_filter *lf)
+{
+	lf->loop_first = 0;
+	lf->loop_end = 0;
+	if (!lf->seamless_loop || lf->ping_pong || !meta_aligned_locked(lf))
+		return;
+
+	const frame_meta_table &m = lf->meta;
+	uint64_t length = m.length();
+	uint64_t min_length = loop_min_span_ns(lf);
+	uint32_t best = UINT32_MAX;
+	size_t first = 0, end = 0;
+	for (size_t i = 0; i < m.count; ++i) {
+		size_t row = m.slot(i);
+		if (!m.valid[row] || m.match_serial[row] == UINT64_MAX || m.match_dist[row] >= best)
+			continue;
+		size_t j = m.row_of_serial(m.match_serial[row]);
+		if (j == SIZE_MAX || m.offset(j) - m.offset(i) < min_length)
+			continue;
+		best = m.match_dist[row];
+		first = i;
+		end = j;
+	}
+	if (best == UINT32_MAX) {
+		blog(LOG_INFO, "[" PLUGIN_ID "] No seamless loop points measured yet, looping the whole buffer");
+		return;
+	}
+
+	lf->loop_first = first;
+	lf->loop_end = end;
+	blog(LOG_INFO, "[" PLUGIN_ID "] Seamless loop over frames %zu-%zu (%.1f of %.1f seconds), seam difference %.1f%%",
+	     first, end - 1, (m.offset(end) - m.offset(first)) / 1e9, length / 1e9,
+	     best * 100.0 / (255.0 * LOOPER_THUMB_BYTES));
+}
+
+// Frame of the loop range [first, end) to enter playback on. The newest frame
+// is the live picture of one capture ago, so it is the entry whenever the loop
+// includes it. Otherwise the entry is the frame closest to the newest measured
+// thumbnail, which probes keep within a few captures of live.
+static size_t entry_frame_locked(loop_filter *lf, size_t first, size_t end)
+{
+	if (end == lf->frame_count || !meta_aligned_locked(lf) || lf->last_thumb_serial == UINT64_MAX)
+		return end - 1;
+
+	const frame_meta_table &m = lf->meta;
+	size_t entry = end - 1;
+	uint32_t best = UINT32_MAX;
+	for (size_t i = end; i-- > first;) {
+		size_t row = m.slot(i);
+		if (!m.valid[row])
+			continue;
+		uint32_t d = thumb_distance(lf->last_thumb, &m.thumb[row * LOOPER_THUMB_BYTES]);
+		if (d < best) {
+			best = d;
+			entry = i;
+		}
+	}
+	blog(LOG_INFO, "[" PLUGIN_ID "] Entering the loop at frame %zu, %.1f%% from the live picture", entry,
+	     best == UINT32_MAX ? 100.0 : best * 100.0 / (255.0 * LOOPER_THUMB_BYTES));
+	return entry;
+}
+
+// Start playback at the loop's frame nearest the live picture, heading backwards into the buffer
+static void start_playback_locked(loop_filter *lf)
+{
+	find_loop_points_locked(lf);
+	size_t first, end;
+	loop_range_locked(lf, &first, &end);
+	lf->play_index = end > 0 ? entry_frame_locked(lf, first, end) : 0;
+	lf->exit_pending = false;
+	lf->direction = -1;
+	lf->total_loops = 0;
+	place_cursor_locked(lf, frame_offset_ns_locked(lf, lf->play_index));
+}
+
+// Run the loop clock 'seconds' of wall time at playback_speed and derive the
+// cursor from it. Ping-pong shows the frame nearest the position, so both end
+// frames stay on screen for one frame duration per turn, as the others do.
+static void advance_playback_locked(loop_filter *lf, double seconds)
+{
+	cursor_shape shape = cursor_shape_locked(lf);
+	if (shape.period <= 0.0)
+		return;
+
+	// Grouped filters take the group's clock and map its phase onto their own
+	// buffer. Otherwise a buffer or mode change reshapes the wave, so carry on
+	// from where the cursor is.
+	if (!sync_advance_locked(lf, seconds)) {
+		if (shape.period != lf->loop_shape_period || shape.ping_pong != lf->loop_shape_ping_pong)
+			place_cursor_locked(lf, lf->play_time);
+		lf->loop_clock += seconds * 1000000000.0 * lf->playback_speed;
+	}
+	double phase = lf->loop_phase + lf->loop_clock;
+	double t = cursor_position(shape, lf->direction, phase, &lf->direction);
+	lf->play_time = t;
+
+	// Every turn or wrap counts as a loop
+	double turns = std::floor(phase / shape.half) - std::floor(lf->loop_phase / shape.half);
+	lf->total_loops = lf->loops_placed + (int)turns;
+	// Prevent overflow of loop counter
+	if (lf->total_loops > 1000000) {
+		lf->total_loops = 0;
+		place_cursor_locked(lf, t);
+	}
+
+	size_t index = frame_at_time_locked(lf, t);
+	lf->blend_index = SIZE_MAX;
+	lf->blend_weight = 0.0f;
+	lf->crossfading = false;
+
+	// The last 'fade' of a forward loop mixes in the frames one period earlier,
+	// from the start of the range, rising to fully theirs at the wrap
+	double fade_from = shape.start + shape.span - shape.fade;
+	if (shape.fade > 0.0 && t >= fade_from) {
+		lf->play_index = index;
+		lf->blend_index = frame_at_time_locked(lf, t - shape.period);
+		lf->blend_weight = (float)clampv((t - fade_from) / shape.fade, 0.0, 1.0);
+		lf->crossfading = true;
+		return;
+	}
+
+	// Blend in the next frame by how far the cursor has moved towards it. Forward
+	// loops blend the last frame of their range into the first as they wrap.
+	// Eased turns hold frames for a while, so they blend even without interpolation.
+	bool easing = shape.ease > 0.0 &&
+		      (t - shape.start < shape.ease / 2.0 || shape.start + shape.span - t < shape.ease / 2.0);
+	if (lf->interpolation != INTERP_NONE || easing) {
+		size_t first, end;
+		loop_range_locked(lf, &first, &end);
+		size_t next = index + 1 < end ? index + 1 : first;
+		double from = frame_offset_ns_locked(lf, index);
+		double to = next > index ? frame_offset_ns_locked(lf, next) : shape.start + shape.span;
+		if (to > from && (next > index || !lf->ping_pong)) {
+			lf->blend_index = next;
+			lf->blend_weight = (float)clampv((t - from) / (to - from), 0.0, 1.0);
+		}
+		lf->play_index = index;
+		return;
+	}
+
+	if (lf->ping_pong && index + 1 < lf->frame_count &&
+	    t - frame_offset_ns_locked(lf, index) > frame_offset_ns_locked(lf, index + 1) - t)
+		index++;
+	lf->play_index = index;
+}
+
+// Mean motion score over the measured frames, 0–1
+static double average_motion_locked(loop_filter *lf, size_t *measured)
+{
+	size_t first, second;
+	lf->meta.spans(&first, &second);
+	const float *motion = lf->meta.motion.data();
+	const uint8_t *valid = lf->meta.valid.data();
+	double total = 0.0;
+	size_t n = 0;
+	for (size_t i = lf->meta.head; i < lf->meta.head + first; ++i) {
+		total += valid[i] ? motion[i] : 0.0f;
+		n += valid[i];
+	}
+	for (size_t i = 0; i < second; ++i) {
+		total += valid[i] ? motion[i] : 0.0f;
+		n += valid[i];
+	}
+	*measured = n;
+	return n ? total / n : 0.0;
+}
+
+static void log_buffer_content_locked(loop_filter *lf)
+{
+	size_t measured = 0;
+	double motion = average_motion_locked(lf, &measured);
+	blog(LOG_INFO,
+	     "[" PLUGIN_ID "] Buffer content: %.1f seconds over %zu frames, average motion %.1f%% (%zu measured)",
+	     buffered_seconds_locked(lf), lf->frame_count, motion * 100.0, measured);
+}
+
+// Loop point candidates. Each row keeps the closest match among the frames
+// captured at least loop_min_span_ns() after it, so a newly measured frame
+// only has to be compared against the older rows: O(n) per capture rather than
+// O(n^2) per search. Evicting old rows never invalidates the others; a partner
+// thinned out of the buffer is skipped when the loop is chosen.
+static void update_loop_matches_locked(loop_filter *lf, size_t index)
+{
+	frame_meta_table &m = lf->meta;
+	size_t row = m.slot(index);
+	const uint8_t *thumb = &m.thumb[row * LOOPER_THUMB_BYTES];
+	uint64_t serial = m.serial[row];
+	uint64_t position = m.offset(index);
+	uint64_t min_span = loop_min_span_ns(lf);
+	for (size_t i = 0; i < index && position - m.offset(i) >= min_span; ++i) {
+		size_t r = m.slot(i);
+		if (!m.valid[r])
+			continue;
+		uint32_t d = thumb_distance(thumb, &m.thumb[r * LOOPER_THUMB_BYTES]);
+		if (d < m.match_dist[r]) {
+			m.match_dist[r] = d;
+			m.match_serial[r] = serial;
+		}
+	}
+}
+
+// Fill in the signature and motion of capture 'serial' from its luma thumbnail.
+// The frame may have left the buffer meanwhile, then the result is dropped.
+static void store_signature_locked(loop_filter *lf, const uint8_t *thumb, uint64_t serial)
+{
+	// Average hash over an 8x8 grid of thumbnail cells: one bit per cell
+	// brighter than the mean of the cells
+	float cells[64];
+	float mean = 0.0f;
+	for (size_t cy = 0; cy < 8; ++cy) {
+		size_t y0 = cy * LOOPER_THUMB_H / 8, y1 = (cy + 1) * LOOPER_THUMB_H / 8;
+		for (size_t cx = 0; cx < 8; ++cx) {
+			size_t x0 = cx * LOOPER_THUMB_W / 8, x1 = (cx + 1) * LOOPER_THUMB_W / 8;
+			uint32_t sum = 0;
+			for (size_t y = y0; y < y1; ++y) {
+				for (size_t x = x0; x < x1; ++x)
+					sum += thumb[y * LOOPER_THUMB_W + x];
+			}
+			cells[cy * 8 + cx] = (float)sum / (float)((y1 - y0) * (x1 - x0));
+			mean += cells[cy * 8 + cx] / 64.0f;
+		}
+	}
+	uint64_t signature = 0;
+	for (size_t i = 0; i < 64; ++i) {
+		if (cells[i] > mean)
+			signature |= 1ull << i;
+	}
+
+	// Motion is the mean luma change from the previous capture, when that was measured too
+	float motion = 0.0f;
+	if (lf->last_thumb_serial + 1 == serial)
+		motion = thumb_distance(thumb, lf->last_thumb) / (255.0f * LOOPER_THUMB_BYTES);
+	memcpy(lf->last_thumb, thumb, LOOPER_THUMB_BYTES);
+	lf->last_thumb_serial = serial;
+
+	// Probes lag only a few captures, so search from the newest row
+	for (size_t i = lf->meta.count; i-- > 0;) {
+		size_t row = lf->meta.slot(i);
+		if (lf->meta.serial[row] < serial)
+			break;
+		if (lf->meta.serial[row] == serial) {
+			lf->meta.signature[row] = signature;
+			lf->meta.motion[row] = motion;
+			lf->meta.valid[row] = 1;
+			memcpy(&lf->meta.thumb[row * LOOPER_THUMB_BYTES], thumb, LOOPER_THUMB_BYTES);
+			if (lf->seamless_loop)
+				update_loop_matches_locked(lf, i);
+			break;
+		}
+	}
+}
+
+// Map a staged probe into 'thumb'
+static bool read_probe(signature_probe &probe, uint8_t *thumb)
+{
+	uint8_t *data = nullptr;
+	uint32_t linesize = 0;
+	if (!probe.stage || !gs_stagesurface_map(probe.stage, &data, &linesize))
+		return false;
+	for (size_t y = 0; y < LOOPER_THUMB_H; ++y)
+		memcpy(thumb + y * LOOPER_THUMB_W, data + y * linesize, LOOPER_THUMB_W);
+	gs_stagesurface_unmap(probe.stage);
+	return true;
+}
+
+// Shrink 'tex' to a luma thumbnail in probe.target and queue its readback
+static bool stage_probe_locked(loop_filter *lf, signature_probe &probe, gs_texture_t *tex)
+{
+	if (!probe.target)
+		probe.target = gs_texrender_create(GS_R8, GS_ZS_NONE);
+	if (!probe.stage)
+		probe.stage = gs_stagesurface_create(LOOPER_THUMB_W, LOOPER_THUMB_H, GS_R8);
+	if (!probe.target || !probe.stage)
+		return false;
+
+	gs_texrender_reset(probe.target);
+	if (!gs_texrender_begin(probe.target, LOOPER_THUMB_W, LOOPER_THUMB_H))
+		return false;
+	gs_ortho(0.0f, (float)LOOPER_THUMB_W, 0.0f, (float)LOOPER_THUMB_H, -100.0f, 100.0f);
+	vec2 thumb_size;
+	vec2_set(&thumb_size, (float)LOOPER_THUMB_W, (float)LOOPER_THUMB_H);
+	gs_effect_set_texture(gs_effect_get_param_by_name(lf->effect, "image"), tex);
+	gs_effect_set_vec2(gs_effect_get_param_by_name(lf->effect, "thumb_size"), &thumb_size);
+	gs_blend_state_push();
+	gs_enable_blending(false);
+	while (gs_effect_loop(lf->effect, "Signature")) {
+		gs_draw_sprite(nullptr, 0, LOOPER_THUMB_W, LOOPER_THUMB_H);
+	}
+	gs_blend_state_pop();
+	gs_texrender_end(probe.target);
+
+	gs_stage_texture(probe.stage, gs_texrender_get_texture(probe.target));
+	return true;
+}
+
+static void complete_probe_locked(loop_filter *lf)
+{
+	signature_probe &probe = lf->probes.at(0);
+	lf->probes.pop();
+
+	uint8_t thumb[LOOPER_THUMB_BYTES];
+	if (read_probe(probe, thumb))
+		store_signature_locked(lf, thumb, probe.serial);
+}
+
+static void flush_probes_locked(loop_filter *lf)
+{
+	while (lf->probes.count > 0)
+		complete_probe_locked(lf);
+}
+
+// Queue a luma thumbnail of capture 'serial', shrunk from its full-quality texture
+static void probe_capture_locked(loop_filter *lf, gs_texture_t *tex, uint64_t serial)
+{
+	if (!lf->effect || !tex || lf->probes.capacity() == 0)
+		return;
+	if (lf->probes.full())
+		complete_probe_locked(lf);
+
+	signature_probe &probe = lf->probes.next();
+	if (!stage_probe_locked(lf, probe, tex))
+		return;
+	probe.serial = serial;
+	lf->probes.push();
+}
+
+// Captures follow a fixed grid of one capture interval, on the clock of the
+// frames themselves: async frame timestamps, or the canvas frame time for
+// rendered sources. A frame is due once it is within a quarter interval of its
+// grid point, so every capture is a distinct frame, arrival jitter doesn't add
+// up to gaps, and sources slower than the capture rate keep every frame.
+static bool capture_due_locked(loop_filter *lf, uint64_t time)
+{
+	uint64_t interval = capture_interval_ns(lf);
+	uint64_t next = lf->next_capture_time;
+
+	// Frames from before the last capture mean the clock restarted
+	if (next == 0 || time + interval < next)
+		return true;
+	return time + interval / 4 >= next;
+}
+
+static void schedule_capture_locked(loop_filter *lf, uint64_t time)
+{
+	uint64_t interval = capture_interval_ns(lf);
+	uint64_t next = lf->next_capture_time;
+
+	// Stay on the grid unless the source fell a whole interval behind it
+	if (next != 0 && time + interval >= next && time < next + interval)
+		lf->next_capture_time = next + interval;
+	else
+		lf->next_capture_time = time + interval;
+}
+
+// ----------------------------- Optical Flow -----------------------------
+
+// Capture number of logical frame 'index', or UINT64_MAX without metadata
+static inline uint64_t frame_serial_locked(const loop_filter *lf, size_t index)
+{
+	if (!meta_aligned_locked(lf) || index >= lf->meta.count)
+		return UINT64_MAX;
+	return lf->meta.serial[lf->meta.slot(index)];
+}
+
+// Run a looper.effect technique over all of 'target' at cx x cy
+static bool flow_pass_locked(loop_filter *lf, gs_texrender_t *target, const char *technique, uint32_t cx, uint32_t cy)
+{
+	gs_texrender_reset(target);
+	if (!gs_texrender_begin(target, cx, cy))
+		return false;
+
+	gs_ortho(0.0f, (float)cx, 0.0f, (float)cy, -100.0f, 100.0f);
+	gs_blend_state_push();
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+	while (gs_effect_loop(lf->effect, technique)) {
+		gs_draw_sprite(nullptr, 0, cx, cy);
+	}
+	gs_blend_state_pop();
+	gs_texrender_end(target);
+	return true;
+}
+
+// Least recently used entry of a flow cache
+template<typename Entry> static Entry &flow_victim(Entry (&entries)[LOOPER_FLOW_CACHE])
+{
+	Entry *victim = &entries[0];
+	for (auto &e : entries) {
+		if (e.used < victim->used)
+			victim = &e;
+	}
+	return *victim;
+}
+
+// Quarter-resolution luma of the stored frame 'tex' with capture number 'serial'
+static gs_texture_t *flow_luma_locked(loop_filter *lf, uint64_t serial, gs_texture_t *tex, uint32_t w, uint32_t h)
+{
+	for (auto &e : lf->flow_lumas) {
+		if (e.serial == serial && e.target) {
+			e.used = ++lf->flow_clock;
+			return gs_texrender_get_texture(e.target);
+		}
+	}
+
+	flow_luma &e = flow_victim(lf->flow_lumas);
+	if (!e.target)
+		e.target = gs_texrender_create(GS_R8, GS_ZS_NONE);
+	if (!e.target)
+		return nullptr;
+
+	uint32_t cx, cy;
+	storage_texture_size(lf->ring_storage, w, h, &cx, &cy);
+	vec2 frame_size, packed_size;
+	vec2_set(&frame_size, (float)w, (float)h);
+	vec2_set(&packed_size, (float)cx, (float)cy);
+	gs_effect_set_texture(gs_effect_get_param_by_name(lf->effect, "image"), tex);
+	gs_effect_set_vec2(gs_effect_get_param_by_name(lf->effect, "frame_size"), &frame_size);
+	gs_effect_set_vec2(gs_effect_get_param_by_name(lf->effect, "packed_size"), &packed_size);
+
+	const char *technique = lf->ring_storage == STORAGE_NV12  ? "LumaNV12"
+				: lf->ring_storage == STORAGE_BC1 ? "LumaBC1"
+								  : "LumaRGBA";
+	e.serial = UINT64_MAX;
+	if (!flow_pass_locked(lf, e.target, technique, (w + 3) / 4, (h + 3) / 4))
+		return nullptr;
+	e.serial = serial;
+	e.used = ++lf->flow_clock;
+	return gs_texrender_get_texture(e.target);
+}
+
+// Block motion from logical frame 'index' to 'next_index', whose stored
+// textures are 'tex' and 'next', measured on the GPU the first time the pair
+// is drawn. Returns nullptr if the pair can't be measured.
+static gs_texture_t *flow_field_locked(loop_filter *lf, size_t index, gs_texture_t *tex, size_t next_index,
+				       gs_texture_t *next, uint32_t w, uint32_t h)
+{
+	uint64_t from = frame_serial_locked(lf, index);
+	uint64_t to = frame_serial_locked(lf, next_index);
+	if (!lf->effect || from == UINT64_MAX || to == UINT64_MAX)
+		return nullptr;
+
+	for (auto &e : lf->flow_fields) {
+		if (e.from == from && e.to == to && e.target) {
+			e.used = ++lf->flow_clock;
+			return gs_texrender_get_texture(e.target);
+		}
+	}
+
+	gs_texture_t *luma_a = flow_luma_locked(lf, from, tex, w, h);
+	gs_texture_t *luma_b = flow_luma_locked(lf, to, next, w, h);
+	if (!luma_a || !luma_b)
+		return nullptr;
+
+	flow_field &e = flow_victim(lf->flow_fields);
+	if (!e.target)
+		e.target = gs_texrender_create(GS_RGBA16F, GS_ZS_NONE);
+	if (!e.target)
+		return nullptr;
+
+	uint32_t lw = (w + 3) / 4;
+	uint32_t lh = (h + 3) / 4;
+	vec2 luma_size;
+	vec2_set(&luma_size, (float)lw, (float)lh);
+	gs_effect_set_texture(gs_effect_get_param_by_name(lf->effect, "image"), luma_a);
+	gs_effect_set_texture(gs_effect_get_param_by_name(lf->effect, "image2"), luma_b);
+	gs_effect_set_vec2(gs_effect_get_param_by_name(lf->effect, "luma_size"), &luma_size);
+
+	e.from = UINT64_MAX;
+	if (!flow_pass_locked(lf, e.target, "MotionSearch", (lw + 7) / 8, (lh + 7) / 8))
+		return nullptr;
+	e.from = from;
+	e.to = to;
+	e.used = ++lf->flow_clock;
+	return gs_texrender_get_texture(e.target);
+}
+
+// Play back two stored frames mixed by 'weight', each sampled along the block
+// motion between them so moving parts meet in the middle instead of ghosting
+static void draw_flow_frames(loop_filter *lf, gs_texture_t *tex, gs_texture_t *next, gs_texture_t *motion,
+			     float weight, uint32_t w, uint32_t h)
+{
+	uint32_t cx, cy;
+	storage_texture_size(lf->ring_storage, w, h, &cx, &cy);
+
+	vec2 frame_size, packed_size;
+	vec2_set(&frame_size, (float)w, (float)h);
+	vec2_set(&packed_size, (float)cx, (float)cy);
+	gs_effect_set_texture(gs_effect_get_param_by_name(lf->effect, "image"), tex);
+	gs_effect_set_texture(gs_effect_get_param_by_name(lf->effect, "image2"), next);
+	gs_effect_set_texture(gs_effect_get_param_by_name(lf->effect, "motion"), motion);
+	gs_effect_set_float(gs_effect_get_param_by_name(lf->effect, "blend"), weight);
+	gs_effect_set_vec2(gs_effect_get_param_by_name(lf->effect, "frame_size"), &frame_size);
+	gs_effect_set_vec2(gs_effect_get_param_by_name(lf->effect, "packed_size"), &packed_size);
+
+	const char *technique = lf->ring_storage == STORAGE_NV12  ? "FlowNV12"
+				: lf->ring_storage == STORAGE_BC1 ? "FlowBC1"
+								  : "FlowRGBA";
+	while (gs_effect_loop(lf->effect, technique)) {
+		gs_draw_sprite(nullptr, 0, w, h);
+	}
+}
+
+static void flow_destroy_locked(loop_filter *lf)
+{
+	for (auto &e : lf->flow_lumas) {
+		if (e.target)
+			gs_texrender_destroy(e.target);
+		e = flow_luma();
+	}
+	for (auto &e : lf->flow_fields) {
+		if (e.target)
+			gs_texrender_destroy(e.target);
+		e = flow_field();
+	}
+}
+
+// ----------------------------- Async Frames -----------------------------
+
+// Async sources (webcams, media) hand libobs CPU frames in their native format,
+// usually NV12 or YUY2. Buffering copies of those avoids any GPU capture and
+// keeps frames at their native size, well under half that of RGBA. Playback
+// hands the copies back through filter_video, so libobs converts them exactly
+// like live frames.
+
+// Bytes held by a frame's planes. Only the 4:2:0 formats have half-height planes.
+static size_t async_frame_bytes(const obs_source_frame *frame)
+{
+	bool half_chroma = frame->format == VIDEO_FORMAT_I420 || frame->format == VIDEO_FORMAT_NV12 ||
+			   frame->format == VIDEO_FORMAT_I010 || frame->format == VIDEO_FORMAT_P010 ||
+			   frame->format == VIDEO_FORMAT_I40A;
+	size_t bytes = 0;
+	for (size_t i = 0; i < MAX_AV_PLANES && frame->data[i]; ++i) {
+		bool chroma = i > 0 && !(frame->format == VIDEO_FORMAT_I40A && i == 3);
+		size_t rows = chroma && half_chroma ? (frame->height + 1) / 2 : frame->height;
+		bytes += (size_t)frame->linesize[i] * rows;
+	}
+	return bytes;
+}
+
+// Luma thumbnail for the frame metadata, averaging a 2x2 grid of samples per
+// texel like a coarser Signature shader. Returns false for formats without 8-bit luma.
+static bool async_luma_thumb(const obs_source_frame *frame, uint8_t *thumb)
+{
+	size_t offset, step;
+	switch (frame->format) {
+	case VIDEO_FORMAT_I420:
+	case VIDEO_FORMAT_NV12:
+	case VIDEO_FORMAT_Y800:
+	case VIDEO_FORMAT_I444:
+	case VIDEO_FORMAT_I422:
+	case VIDEO_FORMAT_I40A:
+	case VIDEO_FORMAT_I42A:
+	case VIDEO_FORMAT_YUVA:
+		offset = 0;
+		step = 1;
+		break;
+	case VIDEO_FORMAT_YUY2:
+	case VIDEO_FORMAT_YVYU:
+		offset = 0;
+		step = 2;
+		break;
+	case VIDEO_FORMAT_UYVY:
+		offset = 1;
+		step = 2;
+		break;
+	default:
+		return false;
+	}
+	if (!frame->data[0] || frame->width == 0 || frame->height == 0)
+		return false;
+
+	// Sample centres on an evenly spaced grid over the whole frame
+	const size_t grid = 2;
+	const size_t samples_x = LOOPER_THUMB_W * grid, samples_y = LOOPER_THUMB_H * grid;
+	for (size_t cy = 0; cy < LOOPER_THUMB_H; ++cy) {
+		for (size_t cx = 0; cx < LOOPER_THUMB_W; ++cx) {
+			uint32_t sum = 0;
+			for (size_t j = 0; j < grid; ++j) {
+				size_t y = ((cy * grid + j) * 2 + 1) * frame->height / (samples_y * 2);
+				const uint8_t *row = frame->data[0] + y * frame->linesize[0];
+				for (size_t i = 0; i < grid; ++i) {
+					size_t x = ((cx * grid + i) * 2 + 1) * frame->width / (samples_x * 2);
+					sum += row[x * step + offset];
+				}
+			}
+			thumb[cy * LOOPER_THUMB_W + cx] = (uint8_t)(sum / (grid * grid));
+		}
+	}
+	return true;
+}
+
+static void pop_async_locked(loop_filter *lf)
+{
+	obs_source_frame *oldest = lf->async_frames.at(0);
+	size_t bytes = oldest ? async_frame_bytes(oldest) : 0;
+	lf->async_bytes = lf->async_bytes > bytes ? lf->async_bytes - bytes : 0;
+	lf->async_frames.pop();
+}
+
+// Copy an incoming async frame into the next free slot as the newest frame,
+// evicting the oldest frames to stay within the frame and RAM limits
+static void async_commit_locked(loop_filter *lf, const obs_source_frame *frame)
+{
+	if (lf->async_frames.capacity() == 0)
+		return;
+
+	size_t bytes = async_frame_bytes(frame);
+	uint64_t limit = (uint64_t)lf->max_ram_mb * 1024 * 1024;
+	while (lf->async_frames.count > 0 && (lf->async_frames.full() || lf->async_bytes + bytes > limit)) {
+		if (!lf->async_frames.full() && !lf->ram_limit_logged) {
+			blog(LOG_WARNING, "[" PLUGIN_ID "] RAM limit of %zuMB reached at %zu async frames",
+			     lf->max_ram_mb, lf->async_frames.count);
+			lf->ram_limit_logged = true;
+		}
+		pop_async_locked(lf);
+	}
+
+	// Slots are reused in place while the source keeps its format and size
+	obs_source_frame *&slot = lf->async_frames.next();
+	if (slot && (slot->format != frame->format || slot->width != frame->width || slot->height != frame->height)) {
+		obs_source_frame_destroy(slot);
+		slot = nullptr;
+	}
+	if (!slot)
+		slot = obs_source_frame_create(frame->format, frame->width, frame->height);
+	if (!slot) {
+		blog(LOG_WARNING, "[" PLUGIN_ID "] Could not allocate a %ux%u async frame, frame dropped", frame->width,
+		     frame->height);
+		return;
+	}
+
+	obs_source_frame_copy(slot, frame);
+	lf->async_frames.push();
+	lf->async_bytes += bytes;
+
+	uint64_t serial = push_meta_locked(lf, frame->timestamp);
+	update_frame_count_locked(lf);
+
+	uint8_t thumb[LOOPER_THUMB_BYTES];
+	if (async_luma_thumb(frame, thumb))
+		store_signature_locked(lf, thumb, serial);
+}
+
+// Thin the buffer to 'target' frames spread evenly over its whole length, the
+// newest frame always kept, so the loop keeps its length at a lower frame rate.
+// Frames stay in their tiers; VRAM frames beyond the new VRAM limit move down
+// to the host tier. Returns the number of frames dropped.
+static size_t decimate_frames_locked(loop_filter *lf, size_t target)
+{
+	if (lf->readback.count > 0)
+		flush_readbacks_locked(lf);
+
+	size_t count = lf->frame_count;
+	if (target == 0 || count <= target)
+		return 0;
+
+	// H.264 frames are decoded from their GOP's keyframe, so none can be skipped
+	if (lf->host_kind == OVERFLOW_ENCODED && lf->host.count > 0) {
+		blog(LOG_INFO, "[" PLUGIN_ID "] H.264 frames can't be thinned out, dropping the oldest frames instead");
+		return 0;
+	}
+
+	// Keep frame i when it crosses a multiple of count/target (Bresenham)
+	auto keep = [count, target](size_t i) { return (i + 1) * target / count > i * target / count; };
+	size_t host_count = lf->host.count;
+	size_t dropped = lf->host.thin(keep, [lf](host_frame &frame) { release_host_frame_locked(lf, frame); });
+	dropped += lf->vram.thin([&keep, host_count](size_t i) { return keep(host_count + i); },
+				 [](gs_texrender_t *) {});
+	dropped += lf->async_frames.thin(keep, [lf](obs_source_frame *frame) {
+		size_t bytes = frame ? async_frame_bytes(frame) : 0;
+		lf->async_bytes = lf->async_bytes > bytes ? lf->async_bytes - bytes : 0;
+	});
+	if (lf->meta.count == count)
+		lf->meta.thin(keep);
+
+	update_frame_count_locked(lf);
+	forget_uploads_locked(lf);
+	lf->play_index = lf->play_index * target / count; // Frames kept before the cursor
+	if (lf->play_index >= lf->frame_count)
+		lf->play_index = lf->frame_count > 0 ? lf->frame_count - 1 : 0;
+	lf->loop_end = 0; // Loop points were frame indices, the whole buffer plays until the next start
+	place_cursor_locked(lf, frame_offset_ns_locked(lf, lf->play_index));
+
+	// The VRAM tier may have shrunk more than the buffer as a whole. Its oldest
+	// frames move down while the host tier stays as it is.
+	if (lf->host_frames > 0 && lf->host_kind == lf->overflow && lf->host.capacity() > 0) {
+		while (lf->vram.count > lf->vram_frames)
+			demote_oldest_locked(lf);
+		flush_readbacks_locked(lf);
+	}
+
+	blog(LOG_INFO, "[" PLUGIN_ID "] Buffer thinned from %zu to %zu frames, keeping %.1f seconds of content", count,
+	     lf->frame_count, buffered_seconds_locked(lf));
+	return dropped;
+}
+
+// (Re)create the host tier for the current overflow tier and frame size. A disk
+// tier maps one preallocated cache file, frame slot i at offset i * frame size;
+// a compressed tier starts its codec workers. Returns the number of buffered
+// frames dropped.
+static size_t rebuild_host_tier_locked(loop_filter *lf, int host_kind)
+{
+	size_t dropped = lf->host.count + lf->readback.count;
+	clear_host_locked(lf);
+	lf->host = {};
+	lf->readback.clear();
+	mapped_file_close(&lf->disk);
+	lf->disk_frame_bytes = 0;
+	codec_stop(&lf->codec);
+	lf->raw_pool.clear();
+	lf->decode_scratch.reset();
+	lf->host_bytes = 0;
+	lf->codec_reported = 0;
+	lf->host_kind = host_kind;
+
+	if (overflow_is_coded(host_kind)) {
+		codec_start(&lf->codec, host_kind);
+		blog(LOG_INFO, "[" PLUGIN_ID "] %s RAM tier: %zu codec threads, up to %zuMB",
+		     host_kind == OVERFLOW_ENCODED ? "H.264" : "Compressed", lf->codec.workers.size(), lf->max_ram_mb);
+	}
+	if (host_kind != OVERFLOW_DISK)
+		return dropped;
+
+	size_t frame_bytes = storage_bytes_per_frame(lf->ring_storage, lf->base_w, lf->base_h);
+	size_t cache_mb = (size_t)(((uint64_t)frame_bytes * lf->host_frames) / (1024 * 1024));
+	char *dir = obs_module_config_path("cache");
+	bool opened = false;
+	if (dir && os_mkdirs(dir) != MKDIR_ERROR) {
+		char path[512];
+		snprintf(path, sizeof(path), "%s/looper-%p.cache", dir, (void *)lf);
+		opened = mapped_file_open(&lf->disk, path, (uint64_t)frame_bytes * lf->host_frames);
+	}
+
+	if (opened) {
+		lf->disk_frame_bytes = frame_bytes;
+		blog(LOG_INFO, "[" PLUGIN_ID "] Disk cache: %zu frames in %zuMB under %s", lf->host_frames, cache_mb,
+		     dir);
+	} else {
+		blog(LOG_WARNING, "[" PLUGIN_ID "] Could not create a %zuMB disk cache, buffer limited to VRAM",
+		     cache_mb);
+		lf->host_kind = OVERFLOW_NONE;
+		lf->host_frames = 0;
+		lf->max_frames = lf->vram_frames;
+	}
+	bfree(dir);
+	return dropped;
+}
+
+// Resize the tiers to the limits chosen by recalc_buffer(), keeping the newest
+// frames in order. Must be called inside the graphics context since slots may
+// be destroyed.
+static void resize_ring_locked(loop_filter *lf)
+{
+	// Thinning keeps the loop's length; whatever still doesn't fit goes oldest first
+	size_t dropped = 0;
+	if (lf->eviction == EVICT_DECIMATE && lf->frame_count > lf->max_frames)
+		dropped += decimate_frames_locked(lf, lf->async_mode || lf->host_frames == 0
+							      ? lf->max_frames
+							      : lf->vram_frames + lf->host_frames);
+
+	// The spare capture slot must stay free
+	while (lf->vram.count > lf->vram_frames) {
+		lf->vram.pop();
+		dropped++;
+	}
+
+	// Async mode keeps no render targets, not even the spare capture slot.
+	// Slots come from and go back to the module's texture pool.
+	uint32_t slot_w, slot_h;
+	storage_texture_size(lf->ring_storage, lf->base_w, lf->base_h, &slot_w, &slot_h);
+	dropped += lf->vram.resize(
+		lf->async_mode ? 0 : lf->vram_frames + 1,
+		[lf, slot_w, slot_h]() { return pool_take(storage_color_format(lf->ring_storage), slot_w, slot_h); },
+		[](gs_texrender_t *tr) { pool_give(tr); });
+
+	// Frames dropped from VRAM leave a gap behind them, so older tiers go too
+	if (dropped > 0 || lf->host_frames == 0) {
+		dropped += lf->host.count + lf->readback.count;
+		clear_host_locked(lf);
+		lf->readback.clear();
+	}
+
+	// The disk cache file is sized for an exact frame count and frame size
+	int host_kind = lf->host_frames > 0 ? lf->overflow : OVERFLOW_NONE;
+	size_t frame_bytes = storage_bytes_per_frame(lf->ring_storage, lf->base_w, lf->base_h);
+	bool disk_changed = host_kind == OVERFLOW_DISK &&
+			    (lf->host.capacity() != lf->host_frames || lf->disk_frame_bytes != frame_bytes);
+	if (host_kind != lf->host_kind || disk_changed)
+		dropped += rebuild_host_tier_locked(lf, host_kind);
+
+	lf->readback.resize(lf->host_frames > 0 ? LOOPER_READBACK_DEPTH : 0, []() { return (gs_stagesurf_t *)nullptr; },
+			    [](gs_stagesurf_t *stage) {
+				    if (stage)
+					    gs_stagesurface_destroy(stage);
+			    });
+	while (lf->host.count > lf->host_frames) {
+		pop_host_locked(lf);
+		dropped++;
+	}
+	size_t next_slot = lf->host.capacity();
+	lf->host.resize(
+		lf->host_frames,
+		[lf, &next_slot]() {
+			host_frame frame;
+			frame.offset = (uint64_t)next_slot++ * lf->disk_frame_bytes;
+			return frame;
+		},
+		[](host_frame &) {});
+
+	size_t async_limit = lf->async_mode ? lf->max_frames : 0;
+	while (lf->async_frames.count > async_limit) {
+		pop_async_locked(lf);
+		dropped++;
+	}
+	lf->async_frames.resize(
+		async_limit, []() { return (obs_source_frame *)nullptr; },
+		[](obs_source_frame *frame) {
+			if (frame)
+				obs_source_frame_destroy(frame);
+		});
 
-OBS_DECLARE_MODULE()
-OBS_MODULE_USE_DEFAULT_LOCALE("obs-pingpong-loop-filter", "en-US")
+	// One more than the frame limit, as a commit briefly holds the spare slot too
+	lf->meta.resize(lf->max_frames + 1);
+	lf->probes.resize(
+		LOOPER_READBACK_DEPTH, []() { return signature_probe(); },
+		[](signature_probe &probe) {
+			if (probe.target)
+				gs_texrender_destroy(probe.target);
+			if (probe.stage)
+				gs_stagesurface_destroy(probe.stage);
+		});
 
-#define PLUGIN_NAME        "Looper"
-#define PLUGIN_ID          "com.biztactix.obs.looper"
+	if (dropped > 0)
+		blog(LOG_INFO, "[" PLUGIN_ID "] Buffer resized to %zu frames, dropped %zu oldest frames",
+		     lf->max_frames, dropped);
 
-// ----------------------------- Utilities -----------------------------
+	forget_uploads_locked(lf);
+	update_frame_count_locked(lf);
+	if (lf->play_index >= lf->frame_count)
+		lf->play_index = lf->frame_count > 0 ? lf->frame_count - 1 : 0;
+	lf->loop_end = 0;
+	place_cursor_locked(lf, frame_offset_ns_locked(lf, lf->play_index));
+}
 
-static inline double fps_from_ovi(const obs_video_info &ovi)
+// Release every tier's allocations. Frame render targets go back to the texture pool.
+static void destroy_ring_locked(loop_filter *lf)
 {
-	return ovi.fps_den ? (double)ovi.fps_num / (double)ovi.fps_den : 60.0;
+	for (auto *tr : lf->vram.slots)
+		pool_give(tr);
+	for (auto *stage : lf->readback.slots) {
+		if (stage)
+			gs_stagesurface_destroy(stage);
+	}
+	for (auto &probe : lf->probes.slots) {
+		if (probe.target)
+			gs_texrender_destroy(probe.target);
+		if (probe.stage)
+			gs_stagesurface_destroy(probe.stage);
+	}
+	for (auto *frame : lf->async_frames.slots) {
+		if (frame)
+			obs_source_frame_destroy(frame);
+	}
+	lf->vram = {};
+	lf->readback = {};
+	lf->host = {};
+	lf->meta = {};
+	lf->probes = {};
+	lf->async_frames = {};
+	lf->async_bytes = 0;
+	lf->frame_count = 0;
+
+	mapped_file_close(&lf->disk);
+	lf->disk_frame_bytes = 0;
+	codec_stop(&lf->codec);
+	lf->raw_pool.clear();
+	lf->decode_scratch.reset();
+	lf->host_bytes = 0;
+	lf->host_kind = OVERFLOW_NONE;
+
+	if (lf->upload_tex) {
+		gs_texture_destroy(lf->upload_tex);
+		lf->upload_tex = nullptr;
+	}
+	if (lf->blend_tex) {
+		gs_texture_destroy(lf->blend_tex);
+		lf->blend_tex = nullptr;
+	}
+	flow_destroy_locked(lf);
+	if (lf->capture_scratch) {
+		gs_texrender_destroy(lf->capture_scratch);
+		lf->capture_scratch = nullptr;
+	}
+	if (lf->live_target) {
+		gs_texrender_destroy(lf->live_target);
+		lf->live_target = nullptr;
+	}
+	gpu_timer_destroy(&lf->capture_gpu);
+	gpu_timer_destroy(&lf->playback_gpu);
+	if (lf->live_probe.target)
+		gs_texrender_destroy(lf->live_probe.target);
+	if (lf->live_probe.stage)
+		gs_stagesurface_destroy(lf->live_probe.stage);
+	lf->live_probe = {};
+	lf->live_thumb_valid = false;
 }
 
-// Clamp utility
-template<typename T> static inline T clampv(T v, T lo, T hi)
+// Allocated size of every texture and staging surface the filter holds. Render
+// targets get their textures on first use, so this grows as the ring fills.
+static size_t owned_vram_bytes_locked(loop_filter *lf)
 {
-	return v < lo ? lo : (v > hi ? hi : v);
+	auto texture_bytes = [](gs_texture_t *tex) -> size_t {
+		return tex ? texture_alloc_bytes(gs_texture_get_color_format(tex), gs_texture_get_width(tex),
+						 gs_texture_get_height(tex))
+			   : 0;
+	};
+	auto stage_bytes = [](gs_stagesurf_t *stage) -> size_t {
+		return stage ? texture_alloc_bytes(gs_stagesurface_get_color_format(stage),
+						   gs_stagesurface_get_width(stage), gs_stagesurface_get_height(stage))
+			     : 0;
+	};
+
+	size_t bytes = 0;
+	for (auto *tr : lf->vram.slots)
+		bytes += tr ? texture_bytes(gs_texrender_get_texture(tr)) : 0;
+	for (auto *stage : lf->readback.slots)
+		bytes += stage_bytes(stage);
+	for (auto &probe : lf->probes.slots) {
+		bytes += probe.target ? texture_bytes(gs_texrender_get_texture(probe.target)) : 0;
+		bytes += stage_bytes(probe.stage);
+	}
+	bytes += lf->capture_scratch ? texture_bytes(gs_texrender_get_texture(lf->capture_scratch)) : 0;
+	bytes += lf->live_target ? texture_bytes(gs_texrender_get_texture(lf->live_target)) : 0;
+	bytes += lf->live_probe.target ? texture_bytes(gs_texrender_get_texture(lf->live_probe.target)) : 0;
+	bytes += stage_bytes(lf->live_probe.stage);
+	bytes += texture_bytes(lf->upload_tex);
+	bytes += texture_bytes(lf->blend_tex);
+	for (auto &e : lf->flow_lumas)
+		bytes += e.target ? texture_bytes(gs_texrender_get_texture(e.target)) : 0;
+	for (auto &e : lf->flow_fields)
+		bytes += e.target ? texture_bytes(gs_texrender_get_texture(e.target)) : 0;
+	return bytes;
 }
 
-// --------------------------- Filter State ----------------------------
+// Forget buffered content but keep every tier's allocations for reuse
+static void clear_frames_locked(loop_filter *lf)
+{
+	if (!lf) {
+		blog(LOG_ERROR, "[" PLUGIN_ID "] clear_frames_locked called with null filter");
+		return;
+	}
 
-struct loop_filter {
-	obs_source_t *context = nullptr;
+	blog(LOG_INFO, "[" PLUGIN_ID "] Clearing %zu frames from buffer", lf->frame_count);
+
+	lf->vram.clear();
+	lf->readback.clear();
+	clear_host_locked(lf);
+	lf->meta.clear();
+	lf->probes.clear();
+	lf->async_frames.clear();
+	lf->async_bytes = 0;
+	lf->last_thumb_serial = UINT64_MAX;
+	lf->frame_count = 0;
+	forget_uploads_locked(lf);
+	lf->ram_limit_logged = false;
+	lf->play_index = 0;
+	lf->direction = +1;
+	lf->play_time = 0.0;
+	lf->loop_end = 0;
+	lf->frame_skip_counter = 0;
+	lf->next_capture_time = 0;
+	lf->source_frame_pending = false;
+}
 
-	// Settings
-	int buffer_seconds = 30; // 10–60
-	bool ping_pong = true;
-	bool loop_enabled = false;
-	double playback_speed = 1.0; // 0.1–2.0x
+static void draw_frame_texture(gs_texture_t *tex, uint32_t w, uint32_t h)
+{
+	gs_effect_t *default_effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
+	gs_eparam_t *image = gs_effect_get_param_by_name(default_effect, "image");
+	gs_effect_set_texture(image, tex);
 
-	// Derived
-	uint32_t base_w = 0;
-	uint32_t base_h = 0;
-	double fps = 60.0;
-	size_t max_frames = 0;
-	int capture_skip_frames = 2; // Capture every Nth frame
+	while (gs_effect_loop(default_effect, "Draw")) {
+		gs_draw_sprite(tex, 0, w, h);
+	}
+}
 
-	// Capture + Playback
-	std::deque<gs_texrender_t *> frames; // FIFO of frame textures
-	std::mutex frames_mtx;
+// Play back a stored frame, converting packed storage back to RGB
+static void draw_stored_frame(loop_filter *lf, gs_texture_t *tex, uint32_t w, uint32_t h)
+{
+	if (lf->ring_storage == STORAGE_RGBA || !lf->effect) {
+		draw_frame_texture(tex, w, h);
+		return;
+	}
 
-	// Playback cursor
-	size_t play_index = 0;    // 0..frames.size()-1
-	int direction = +1;       // +1 forward, -1 backward
-	double frame_accum = 0.0; // fractional frame step timing
-	int total_loops = 0;      // Track how many times we've looped
+	uint32_t cx, cy;
+	storage_texture_size(lf->ring_storage, w, h, &cx, &cy);
 
-	// Hotkey
-	obs_hotkey_id hotkey_toggle = OBS_INVALID_HOTKEY_ID;
+	vec2 frame_size, packed_size;
+	vec2_set(&frame_size, (float)w, (float)h);
+	vec2_set(&packed_size, (float)cx, (float)cy);
+	gs_effect_set_texture(gs_effect_get_param_by_name(lf->effect, "image"), tex);
+	gs_effect_set_vec2(gs_effect_get_param_by_name(lf->effect, "frame_size"), &frame_size);
+	gs_effect_set_vec2(gs_effect_get_param_by_name(lf->effect, "packed_size"), &packed_size);
 
-	// Frame capture state
-	bool dimensions_valid = false;
-	int frame_skip_counter = 0;     // To reduce capture rate
-	uint64_t last_capture_time = 0; // Track last capture time in nanoseconds
+	while (gs_effect_loop(lf->effect, storage_technique(lf->ring_storage, false))) {
+		gs_draw_sprite(nullptr, 0, w, h);
+	}
+}
 
-	// UI state - removed toggle_button pointer to avoid lifetime issues
-	double last_ui_update = 0.0;        // Track last UI update time
-	uint64_t capture_start_time = 0;    // Track when capture started (nanoseconds)
-	size_t frames_captured_count = 0;   // Track total frames captured
-	size_t last_logged_frame_count = 0; // Track last frame count for UI updates
+// Play back two stored frames mixed by 'weight', unpacking both in one pass
+static void draw_blended_frames(loop_filter *lf, gs_texture_t *tex, gs_texture_t *next, float weight, uint32_t w,
+				uint32_t h)
+{
+	if (!lf->effect) {
+		draw_stored_frame(lf, tex, w, h);
+		return;
+	}
 
-	// Resource management
-	size_t max_memory_mb = 4096;     // Maximum memory usage in MB (default 4GB)
-	size_t current_memory_usage = 0; // Track current memory usage
-	uint32_t last_width = 0;         // Track resolution changes
-	uint32_t last_height = 0;
-};
+	uint32_t cx, cy;
+	storage_texture_size(lf->ring_storage, w, h, &cx, &cy);
 
-// ----------------------------- Forward Decls -----------------------------
+	vec2 frame_size, packed_size;
+	vec2_set(&frame_size, (float)w, (float)h);
+	vec2_set(&packed_size, (float)cx, (float)cy);
+	gs_effect_set_texture(gs_effect_get_param_by_name(lf->effect, "image"), tex);
+	gs_effect_set_texture(gs_effect_get_param_by_name(lf->effect, "image2"), next);
+	gs_effect_set_float(gs_effect_get_param_by_name(lf->effect, "blend"), weight);
+	gs_effect_set_vec2(gs_effect_get_param_by_name(lf->effect, "frame_size"), &frame_size);
+	gs_effect_set_vec2(gs_effect_get_param_by_name(lf->effect, "packed_size"), &packed_size);
 
-static const char *loop_filter_get_name(void *);
-static void *loop_filter_create(obs_data_t *settings, obs_source_t *context);
-static void loop_filter_destroy(void *data);
-static void loop_filter_update(void *data, obs_data_t *settings);
-static obs_properties_t *loop_filter_properties(void *data);
-static void loop_filter_get_defaults(obs_data_t *settings);
-static void loop_filter_tick(void *data, float seconds);
-static void loop_filter_render(void *data, gs_effect_t *effect);
-static void loop_filter_show(void *data);
-static void loop_filter_hide(void *data);
+	while (gs_effect_loop(lf->effect, blend_technique(lf->ring_storage))) {
+		gs_draw_sprite(nullptr, 0, w, h);
+	}
+}
 
-// Hotkey
-static void loop_filter_register_hotkeys(loop_filter *lf);
-static void loop_filter_toggle_cb(void *data, obs_hotkey_id id, obs_hotkey_t *hotkey, bool pressed);
+// Render the parent source into 'target' at w x h
+static bool render_parent_locked(loop_filter *lf, gs_texrender_t *target, uint32_t w, uint32_t h)
+{
+	if (!gs_texrender_begin(target, w, h))
+		return false;
+
+	vec4 clear_color = {0.0f, 0.0f, 0.0f, 0.0f};
+	gs_clear(GS_CLEAR_COLOR, &clear_color, 1.0f, 0);
+	gs_ortho(0.0f, (float)w, 0.0f, (float)h, -100.0f, 100.0f);
+
+	// Same blend setup as obs_source_process_filter_begin
+	gs_blend_state_push();
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+	obs_source_t *parent = obs_filter_get_parent(lf->context);
+	if (parent) {
+		obs_source_video_render(parent);
+	}
+	gs_blend_state_pop();
 
-// ----------------------------- Helpers -----------------------------
+	gs_texrender_end(target);
+	return true;
+}
 
-static void clear_frames_locked(loop_filter *lf)
+// Convert a full-quality capture into the packed layout of the ring's storage mode
+static bool pack_frame_locked(loop_filter *lf, gs_texture_t *src, gs_texrender_t *slot, uint32_t w, uint32_t h)
 {
-	if (!lf) {
-		blog(LOG_ERROR, "[" PLUGIN_ID "] clear_frames_locked called with null filter");
-		return;
+	uint32_t cx, cy;
+	storage_texture_size(lf->ring_storage, w, h, &cx, &cy);
+	if (!lf->effect || !src || !gs_texrender_begin(slot, cx, cy))
+		return false;
+
+	gs_ortho(0.0f, (float)cx, 0.0f, (float)cy, -100.0f, 100.0f);
+
+	vec2 frame_size, packed_size;
+	vec2_set(&frame_size, (float)w, (float)h);
+	vec2_set(&packed_size, (float)cx, (float)cy);
+	gs_effect_set_texture(gs_effect_get_param_by_name(lf->effect, "image"), src);
+	gs_effect_set_vec2(gs_effect_get_param_by_name(lf->effect, "frame_size"), &frame_size);
+	gs_effect_set_vec2(gs_effect_get_param_by_name(lf->effect, "packed_size"), &packed_size);
+
+	gs_blend_state_push();
+	gs_enable_blending(false);
+	while (gs_effect_loop(lf->effect, storage_technique(lf->ring_storage, true))) {
+		gs_draw_sprite(nullptr, 0, cx, cy);
 	}
+	gs_blend_state_pop();
 
-	blog(LOG_INFO, "[" PLUGIN_ID "] Clearing %zu frames from buffer", lf->frames.size());
+	gs_texrender_end(slot);
+	return true;
+}
 
-	for (auto *tr : lf->frames) {
-		if (tr) {
-			gs_texrender_destroy(tr);
-		}
+// Capture the parent into 'slot' with a single render of the parent. Returns the
+// full-quality texture to show as this frame's output, or nullptr on failure.
+static gs_texture_t *capture_frame_locked(loop_filter *lf, gs_texrender_t *slot, uint32_t w, uint32_t h)
+{
+	if (lf->ring_storage == STORAGE_RGBA) {
+		if (!render_parent_locked(lf, slot, w, h))
+			return nullptr;
+		return gs_texrender_get_texture(slot);
 	}
-	lf->frames.clear();
-	lf->play_index = 0;
-	lf->direction = +1;
-	lf->frame_accum = 0.0;
-	lf->frame_skip_counter = 0;
-	lf->last_capture_time = 0;
+
+	// Packed modes render at full quality first, then convert into the slot
+	if (!lf->capture_scratch)
+		lf->capture_scratch = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+	if (!lf->capture_scratch)
+		return nullptr;
+
+	gs_texrender_reset(lf->capture_scratch);
+	if (!render_parent_locked(lf, lf->capture_scratch, w, h))
+		return nullptr;
+
+	gs_texture_t *full = gs_texrender_get_texture(lf->capture_scratch);
+	if (!pack_frame_locked(lf, full, slot, w, h))
+		return nullptr;
+	return full;
+}
+
+// Largest mean luma difference, 0-1, at which a buffered frame passes for the
+// live picture, and how long a stop may wait for one
+#define LOOPER_EXIT_MATCH      0.04
+#define LOOPER_EXIT_TIMEOUT_NS 10000000000ull
+
+// Stop requests wait for a frame that matches live when exit_on_match is set.
+// Returns true if the stop was deferred; a second request stops at once.
+static bool defer_loop_exit_locked(loop_filter *lf)
+{
+	if (!lf->exit_on_match || lf->exit_pending || lf->frame_count == 0) {
+		lf->exit_pending = false;
+		return false;
+	}
+	lf->exit_pending = true;
+	lf->exit_requested_at = os_gettime_ns();
+	lf->live_thumb_valid = false;
+	lf->live_probe.serial = 0;
+	return true;
+}
+
+// While a stop waits, thumbnail the parent's live render. The readback is mapped
+// one frame later, so the loop never waits on the GPU for it.
+static void probe_live_locked(loop_filter *lf, uint32_t w, uint32_t h)
+{
+	if (lf->live_probe.serial != 0) {
+		lf->live_thumb_valid = read_probe(lf->live_probe, lf->live_thumb);
+		lf->live_probe.serial = 0;
+	}
+	if (!lf->effect)
+		return;
+
+	if (!lf->live_target)
+		lf->live_target = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+	if (!lf->live_target)
+		return;
+	gs_texrender_reset(lf->live_target);
+	if (render_parent_locked(lf, lf->live_target, w, h) &&
+	    stage_probe_locked(lf, lf->live_probe, gs_texrender_get_texture(lf->live_target)))
+		lf->live_probe.serial = 1;
+}
+
+// Finish a deferred stop once the frame on screen is close to the live
+// picture, or when none has been for LOOPER_EXIT_TIMEOUT_NS. Returns true if
+// the loop stopped.
+static bool check_loop_exit_locked(loop_filter *lf)
+{
+	if (!lf->exit_pending)
+		return false;
+
+	double diff = 1.0;
+	if (lf->live_thumb_valid && meta_aligned_locked(lf) && lf->play_index < lf->meta.count) {
+		size_t row = lf->meta.slot(lf->play_index);
+		if (lf->meta.valid[row])
+			diff = thumb_distance(lf->live_thumb, &lf->meta.thumb[row * LOOPER_THUMB_BYTES]) /
+			       (255.0 * LOOPER_THUMB_BYTES);
+	}
+	uint64_t waited = os_gettime_ns() - lf->exit_requested_at;
+	if (diff > LOOPER_EXIT_MATCH && waited < LOOPER_EXIT_TIMEOUT_NS)
+		return false;
+
+	lf->exit_pending = false;
+	lf->loop_enabled = false;
+	if (diff <= LOOPER_EXIT_MATCH)
+		blog(LOG_INFO, "[" PLUGIN_ID "] Loop STOPPED on frame %zu, %.1f%% from live after %.1f seconds",
+		     lf->play_index, diff * 100.0, waited / 1e9);
+	else
+		blog(LOG_INFO, "[" PLUGIN_ID "] Loop STOPPED: no frame matched live within %.0f seconds",
+		     LOOPER_EXIT_TIMEOUT_NS / 1e9);
+	obs_source_update_properties(lf->context);
+	return true;
 }
 
-static size_t estimate_memory_usage(uint32_t width, uint32_t height, size_t frame_count)
+static size_t estimate_memory_usage(int storage, uint32_t width, uint32_t height, size_t frame_count)
 {
-	// Each frame uses approximately width * height * 4 bytes (RGBA)
-	// Plus overhead for texrender structure
-	size_t bytes_per_frame = width * height * 4 + 256;      // 256 bytes overhead estimate
-	return (bytes_per_frame * frame_count) / (1024 * 1024); // Return in MB
+	// Each frame uses the storage mode's texture (4 bytes/px RGBA, 1.5 NV12, 0.5 BC1)
+	// as the driver allocates it, padded rows and pages included
+	size_t bytes_per_frame = storage_alloc_bytes(storage, width, height);
+	return (size_t)(((uint64_t)bytes_per_frame * frame_count) / (1024 * 1024)); // Return in MB
 }
 
 static void recalc_buffer(loop_filter *lf)
@@ -146,16 +4124,59 @@ static void recalc_buffer(loop_filter *lf)
 	// If OBS is 60fps and we skip every 2 frames, we capture at 30fps
 	// But we need to account for the actual render callback rate
 	double effective_fps = lf->fps / lf->capture_skip_frames;
-	lf->max_frames = (size_t)std::llround(effective_fps * clampv(lf->buffer_seconds, 10, 60));
+	lf->max_frames =
+		(size_t)std::llround(effective_fps * clampv(lf->buffer_seconds, 10, max_buffer_seconds(lf->overflow)));
 	if (lf->max_frames < 2)
 		lf->max_frames = 2;
 
-	// Check memory limits if we have dimensions
-	if (lf->base_w > 0 && lf->base_h > 0) {
-		size_t estimated_mb = estimate_memory_usage(lf->base_w, lf->base_h, lf->max_frames);
-		if (estimated_mb > lf->max_memory_mb) {
+	lf->vram_frames = lf->max_frames;
+	lf->host_frames = 0;
+	size_t requested_frames = lf->max_frames;
+
+	// Claim VRAM for the full buffer; async frames and unknown sizes need none yet
+	size_t demand_mb = 0;
+	if (!lf->async_mode && lf->base_w > 0 && lf->base_h > 0)
+		demand_mb = estimate_memory_usage(lf->storage, lf->base_w, lf->base_h, lf->max_frames);
+	lf->max_memory_mb = budget_request(lf, demand_mb);
+
+	// Check memory limits if we have dimensions. Async frames stay in system RAM
+	// and are held to max_ram_mb as they arrive.
+	if (lf->async_mode) {
+		lf->vram_frames = 0;
+	} else if (lf->base_w > 0 && lf->base_h > 0) {
+		size_t estimated_mb = estimate_memory_usage(lf->storage, lf->base_w, lf->base_h, lf->max_frames);
+		size_t frame_bytes = storage_bytes_per_frame(lf->storage, lf->base_w, lf->base_h);
+		size_t alloc_bytes = storage_alloc_bytes(lf->storage, lf->base_w, lf->base_h);
+		size_t vram_fit = (lf->max_memory_mb * 1024 * 1024) / alloc_bytes;
+		size_t vram_frames = vram_fit > LOOPER_READBACK_DEPTH + 2 ? vram_fit - LOOPER_READBACK_DEPTH : 2;
+		size_t spill_frames = lf->max_frames > vram_frames + LOOPER_READBACK_DEPTH
+					      ? lf->max_frames - vram_frames - LOOPER_READBACK_DEPTH
+					      : 0;
+
+		if (estimated_mb > lf->max_memory_mb && lf->overflow != OVERFLOW_NONE && spill_frames > 0) {
+			// Newest frames stay in VRAM (with in-flight readbacks counted against
+			// it), everything older spills to system RAM or the disk cache
+			// Coded tiers enforce their RAM limit in bytes as frames arrive
+			bool disk = lf->overflow == OVERFLOW_DISK;
+			size_t limit_mb = disk ? lf->max_disk_mb : lf->max_ram_mb;
+			size_t host_fit = overflow_is_coded(lf->overflow)
+						  ? spill_frames
+						  : (size_t)(((uint64_t)limit_mb * 1024 * 1024) / frame_bytes);
+			lf->vram_frames = vram_frames;
+			lf->host_frames = spill_frames < host_fit ? spill_frames : host_fit;
+			if (lf->host_frames < spill_frames)
+				blog(LOG_WARNING,
+				     "[" PLUGIN_ID "] %s limit reached: %zuMB allows %zu of %zu spilled frames",
+				     disk ? "Disk cache" : "RAM", limit_mb, lf->host_frames, spill_frames);
+			lf->max_frames = lf->vram_frames + LOOPER_READBACK_DEPTH + lf->host_frames;
+			blog(LOG_INFO,
+			     "[" PLUGIN_ID "] VRAM budget %zuMB holds %zu frames, spilling %zu older frames (%zuMB) to %s",
+			     lf->max_memory_mb, lf->vram_frames, lf->host_frames,
+			     (size_t)(((uint64_t)lf->host_frames * frame_bytes) / (1024 * 1024)),
+			     disk ? "the disk cache" : (overflow_is_coded(lf->overflow) ? "compressed system RAM" : "system RAM"));
+		} else if (estimated_mb > lf->max_memory_mb) {
 			// Reduce frame count to fit within memory limit
-			size_t new_max_frames = (lf->max_memory_mb * 1024 * 1024) / (lf->base_w * lf->base_h * 4 + 256);
+			size_t new_max_frames = (lf->max_memory_mb * 1024 * 1024) / alloc_bytes;
 			blog(LOG_WARNING,
 			     "[" PLUGIN_ID
 			     "] Memory limit exceeded! Estimated: %zuMB > Limit: %zuMB. Reducing frames from %zu to %zu",
@@ -163,14 +4184,44 @@ static void recalc_buffer(loop_filter *lf)
 			lf->max_frames = new_max_frames;
 			if (lf->max_frames < 2)
 				lf->max_frames = 2;
+			lf->vram_frames = lf->max_frames;
 		}
 	}
 
+	// Decimation spaces captures out so the frames that fit still span the buffer length
+	lf->capture_stretch = 1.0;
+	if (lf->eviction == EVICT_DECIMATE && lf->max_frames < requested_frames) {
+		lf->capture_stretch = (double)requested_frames / (double)lf->max_frames;
+		effective_fps /= lf->capture_stretch;
+		blog(LOG_INFO, "[" PLUGIN_ID "] Thinning to %zu of %zu frames: capturing at %.1f fps to keep %d seconds",
+		     lf->max_frames, requested_frames, effective_fps, lf->buffer_seconds);
+	}
+
 	double base_playback = lf->buffer_seconds * 2.0; // ping-pong at 1x speed
 	blog(LOG_INFO,
 	     "[" PLUGIN_ID
 	     "] Buffer config: %d seconds content, skip=%d frames, effective fps=%.1f, max_frames=%zu (ping-pong at 1x = %.1f seconds)",
 	     lf->buffer_seconds, lf->capture_skip_frames, effective_fps, lf->max_frames, base_playback);
+
+	// Size the ring once here; captures then overwrite slots in place
+	obs_enter_graphics();
+	{
+		std::lock_guard<std::mutex> lk(lf->frames_mtx);
+		if (lf->ring_storage != lf->storage) {
+			// Slot formats differ between storage modes, so rebuild the ring
+			if (lf->frame_count > 0) {
+				blog(LOG_INFO, "[" PLUGIN_ID "] Storage mode changed - clearing buffer");
+				clear_frames_locked(lf);
+				lf->capture_start_time = 0;
+				lf->frames_captured_count = 0;
+				lf->last_logged_frame_count = 0;
+			}
+			destroy_ring_locked(lf);
+			lf->ring_storage = lf->storage;
+		}
+		resize_ring_locked(lf);
+	}
+	obs_leave_graphics();
 }
 
 // ----------------------------- OBS Callbacks -----------------------------
@@ -194,8 +4245,19 @@ static void *loop_filter_create(obs_data_t *settings, obs_source_t *context)
 	lf->base_w = 0;
 	lf->base_h = 0;
 	lf->dimensions_valid = false;
+	lf->capture_gpu.name = "capture";
+	lf->playback_gpu.name = "playback";
+
+	char *effect_path = obs_module_file("looper.effect");
+	obs_enter_graphics();
+	lf->effect = effect_path ? gs_effect_create_from_file(effect_path, nullptr) : nullptr;
+	obs_leave_graphics();
+	if (!lf->effect)
+		blog(LOG_WARNING, "[" PLUGIN_ID "] Could not load looper.effect, only full quality storage available");
+	bfree(effect_path);
 
 	loop_filter_get_defaults(settings);
+	budget_register(lf);
 	loop_filter_update(lf, settings);
 	recalc_buffer(lf);
 	loop_filter_register_hotkeys(lf);
@@ -212,11 +4274,22 @@ static void loop_filter_destroy(void *data)
 
 	blog(LOG_INFO, "[" PLUGIN_ID "] Destroying filter instance...");
 
+	// Hand this filter's VRAM share back to the others
+	size_t remaining = budget_unregister(lf);
+	if (!lf->sync_group.empty())
+		sync_leave(lf->sync_group);
+
 	obs_enter_graphics();
 	{
 		std::lock_guard<std::mutex> lk(lf->frames_mtx);
 		clear_frames_locked(lf);
+		destroy_ring_locked(lf);
 	}
+	// Pooled targets only serve other filters
+	if (remaining == 0)
+		pool_trim(UINT64_MAX);
+	if (lf->effect)
+		gs_effect_destroy(lf->effect);
 	obs_leave_graphics();
 
 	delete lf;
@@ -228,27 +4301,59 @@ static void loop_filter_update(void *data, obs_data_t *settings)
 	if (!lf)
 		return;
 
-	lf->buffer_seconds = (int)obs_data_get_int(settings, "buffer_seconds");
-	lf->buffer_seconds = clampv(lf->buffer_seconds, 10, 60);
+	lf->overflow = (int)obs_data_get_int(settings, "overflow_tier");
+	lf->max_ram_mb = (size_t)clampv((int)obs_data_get_int(settings, "max_ram_mb"), 512, 262144);
+	lf->max_disk_mb = (size_t)clampv((int)obs_data_get_int(settings, "max_disk_mb"), 1024, 1048576);
 
+	lf->buffer_seconds = (int)obs_data_get_int(settings, "buffer_seconds");
+	lf->buffer_seconds = clampv(lf->buffer_seconds, 10, max_buffer_seconds(lf->overflow));
+
+	lf->async_capture = obs_data_get_bool(settings, "async_capture");
+	lf->eviction = obs_data_get_int(settings, "eviction_policy") == EVICT_DECIMATE ? EVICT_DECIMATE : EVICT_OLDEST;
+	lf->interpolation = (int)obs_data_get_int(settings, "interpolation");
+	if (lf->interpolation != INTERP_BLEND && lf->interpolation != INTERP_FLOW)
+		lf->interpolation = INTERP_NONE;
+	lf->vram_priority = (int)obs_data_get_int(settings, "vram_priority");
+	if (lf->vram_priority != PRIORITY_LOW && lf->vram_priority != PRIORITY_HIGH)
+		lf->vram_priority = PRIORITY_NORMAL;
 	lf->ping_pong = obs_data_get_bool(settings, "ping_pong");
+	lf->seamless_loop = obs_data_get_bool(settings, "seamless_loop");
+	lf->exit_on_match = obs_data_get_bool(settings, "exit_on_match");
+	lf->crossfade_frames = clampv((int)obs_data_get_int(settings, "crossfade_frames"), 0, 120);
+	lf->ease_seconds = clampv(obs_data_get_double(settings, "ease_seconds"), 0.0, 5.0);
 	lf->playback_speed = obs_data_get_double(settings, "playback_speed");
-	lf->playback_speed = clampv(lf->playback_speed, 0.1, 2.0);
-
-	recalc_buffer(lf);
-
-	// If we shrank the buffer, trim old frames
-	obs_enter_graphics();
+	lf->playback_speed = clampv(lf->playback_speed, 0.01, 64.0);
 	{
 		std::lock_guard<std::mutex> lk(lf->frames_mtx);
-		while (lf->frames.size() > lf->max_frames) {
-			auto *f = lf->frames.front();
-			lf->frames.pop_front();
-			if (f)
-				gs_texrender_destroy(f);
+		lf->sync_group_setting = obs_data_get_string(settings, "sync_group");
+	}
+
+	// Packed storage needs the conversion shaders
+	lf->storage = (int)obs_data_get_int(settings, "storage_format");
+	if ((lf->storage != STORAGE_NV12 && lf->storage != STORAGE_BC1) || !lf->effect)
+		lf->storage = STORAGE_RGBA;
+
+	// H.264 encodes frames straight from the compact YUV layout. Without the
+	// x264 encoder, FFmpeg support or the shaders for that layout, fall back to
+	// lossless compression. The Frame Storage setting is left as chosen, and
+	// applies again once another overflow tier is selected.
+	if (lf->overflow == OVERFLOW_ENCODED) {
+#ifdef LOOPER_ENCODED_RING
+		if (lf->effect && obs_get_encoder_codec("obs_x264")) {
+			if (lf->storage != STORAGE_NV12)
+				blog(LOG_INFO, "[" PLUGIN_ID "] H.264 overflow stores frames as Compact (YUV 4:2:0), "
+					       "Frame Storage setting ignored");
+			lf->storage = STORAGE_NV12;
+		} else {
+			lf->overflow = OVERFLOW_COMPRESSED;
 		}
+#else
+		lf->overflow = OVERFLOW_COMPRESSED;
+#endif
 	}
-	obs_leave_graphics();
+
+	// Resizes the ring; a smaller buffer keeps the newest frames
+	recalc_buffer(lf);
 }
 
 static obs_properties_t *loop_filter_properties(void *data)
@@ -273,13 +4378,72 @@ static obs_properties_t *loop_filter_properties(void *data)
 			double actual_duration = base_duration / lf->playback_speed;
 			char duration_text[256];
 			snprintf(duration_text, sizeof(duration_text),
-				 "⏱️ Playback Duration: %.1f seconds at %.1fx speed", actual_duration,
+				 "⏱️ Playback Duration: %.1f seconds at %.2fx speed", actual_duration,
 				 lf->playback_speed);
 			obs_property_set_description(obs_properties_get(props, "duration_info"), duration_text);
 		}
 		return true;
 	});
 
+	// Frame storage format; changing it clears the buffer
+	auto *storage_prop = obs_properties_add_list(props, "storage_format", "Frame Storage", OBS_COMBO_TYPE_LIST,
+						     OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(storage_prop, "Full Quality (RGBA, 4 bytes/pixel)", STORAGE_RGBA);
+	obs_property_list_add_int(storage_prop, "Compact (YUV 4:2:0, 1.5 bytes/pixel, no transparency)",
+				  STORAGE_NV12);
+	obs_property_list_add_int(storage_prop, "Compressed (4x4 blocks, 0.5 bytes/pixel, lossy, no transparency)",
+				  STORAGE_BC1);
+
+	// Where frames go once the VRAM budget is full
+	auto *overflow_prop = obs_properties_add_list(props, "overflow_tier", "Overflow Storage", OBS_COMBO_TYPE_LIST,
+						      OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(overflow_prop, "None (shorten buffer to fit VRAM)", OVERFLOW_NONE);
+	obs_property_list_add_int(overflow_prop, "System RAM", OVERFLOW_SYSTEM_RAM);
+	obs_property_list_add_int(overflow_prop, "Disk Cache (allows loops up to 10 minutes)", OVERFLOW_DISK);
+	obs_property_list_add_int(overflow_prop, "Compressed System RAM (lossless, allows loops up to 10 minutes)",
+				  OVERFLOW_COMPRESSED);
+#ifdef LOOPER_ENCODED_RING
+	const char *encoded_label = "H.264 Encoded System RAM (uses Compact storage, loops up to 10 minutes)";
+	size_t encoded_item = obs_property_list_add_int(overflow_prop, encoded_label, OVERFLOW_ENCODED);
+	obs_property_list_item_disable(overflow_prop, encoded_item, !obs_get_encoder_codec("obs_x264"));
+#endif
+	obs_properties_add_int(props, "max_ram_mb", "System RAM Limit (MB)", 512, 262144, 512);
+	obs_properties_add_int(props, "max_disk_mb", "Disk Cache Limit (MB)", 1024, 1048576, 1024);
+
+	// All Looper filters share one VRAM budget, split by this weight
+	auto *priority_prop = obs_properties_add_list(props, "vram_priority", "VRAM Priority", OBS_COMBO_TYPE_LIST,
+						      OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(priority_prop, "Low", PRIORITY_LOW);
+	obs_property_list_add_int(priority_prop, "Normal", PRIORITY_NORMAL);
+	obs_property_list_add_int(priority_prop, "High", PRIORITY_HIGH);
+
+	// What gives when the buffer no longer fits its memory limit
+	auto *eviction_prop = obs_properties_add_list(props, "eviction_policy", "When Memory Runs Short",
+						      OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(eviction_prop, "Drop oldest frames (shorter loop, smooth)", EVICT_OLDEST);
+	obs_property_list_add_int(eviction_prop, "Thin out frames evenly (full loop length, lower frame rate)",
+				  EVICT_DECIMATE);
+
+	// Webcams and media sources are buffered as their own YUV frames, without GPU capture
+	auto *async_prop =
+		obs_properties_add_bool(props, "async_capture", "Buffer Webcam/Media Frames Directly (system RAM)");
+
+	// The RAM limit covers the RAM overflow tiers and directly buffered frames
+	auto limits_modified = [](obs_properties_t *props, obs_property_t *, obs_data_t *settings) {
+		int overflow = (int)obs_data_get_int(settings, "overflow_tier");
+		obs_property_set_visible(obs_properties_get(props, "max_ram_mb"),
+					 overflow == OVERFLOW_SYSTEM_RAM || overflow_is_coded(overflow) ||
+						 obs_data_get_bool(settings, "async_capture"));
+		obs_property_set_visible(obs_properties_get(props, "max_disk_mb"), overflow == OVERFLOW_DISK);
+		// H.264 overflow always stores frames as Compact, whatever Frame Storage says
+		obs_property_set_enabled(obs_properties_get(props, "storage_format"), overflow != OVERFLOW_ENCODED);
+		obs_property_int_set_limits(obs_properties_get(props, "buffer_seconds"), 10,
+					    max_buffer_seconds(overflow), 1);
+		return true;
+	};
+	obs_property_set_modified_callback(overflow_prop, limits_modified);
+	obs_property_set_modified_callback(async_prop, limits_modified);
+
 	// Add ping-pong toggle with callback
 	auto *pingpong_prop = obs_properties_add_bool(props, "ping_pong", "Ping-Pong (Forward/Reverse)");
 	obs_property_set_modified_callback(pingpong_prop, [](obs_properties_t *props, obs_property_t *,
@@ -292,15 +4456,31 @@ static obs_properties_t *loop_filter_properties(void *data)
 			double actual_duration = base_duration / lf->playback_speed;
 			char duration_text[256];
 			snprintf(duration_text, sizeof(duration_text),
-				 "⏱️ Playback Duration: %.1f seconds at %.1fx speed", actual_duration,
+				 "⏱️ Playback Duration: %.1f seconds at %.2fx speed", actual_duration,
 				 lf->playback_speed);
 			obs_property_set_description(obs_properties_get(props, "duration_info"), duration_text);
 		}
 		return true;
 	});
 
-	// Add playback speed with callback
-	auto *speed_prop = obs_properties_add_float_slider(props, "playback_speed", "Playback Speed", 0.1, 2.0, 0.1);
+	// Forward loops between the two most similar frames instead of jumping from newest to oldest
+	obs_properties_add_bool(props, "seamless_loop", "Seamless Loop Points (without Ping-Pong)");
+
+	// Ping-pong slows into each turn and speeds up out of it instead of reversing at once
+	obs_properties_add_float_slider(props, "ease_seconds", "Ease Ping-Pong Turns (seconds, 0 = off)", 0.0, 5.0,
+					0.1);
+
+	// Forward loops blend their last frames into their first instead of cutting at the wrap
+	obs_properties_add_int_slider(props, "crossfade_frames", "Loop Crossfade Frames (without Ping-Pong, 0 = off)", 0,
+				      120, 1);
+
+	// Stopping keeps the loop playing until it shows a frame close to the live picture
+	obs_properties_add_bool(props, "exit_on_match", "Stop Loop on a Frame Matching Live");
+
+	// Add playback speed with callback. A spin box, since a slider across
+	// 0.01-64x leaves the usual speeds in a few pixels at one end.
+	auto *speed_prop = obs_properties_add_float(props, "playback_speed", "Playback Speed", 0.01, 64.0, 0.01);
+	obs_property_float_set_suffix(speed_prop, "x");
 	obs_property_set_modified_callback(speed_prop, [](obs_properties_t *props, obs_property_t *,
 							  obs_data_t *settings) {
 		auto *lf = reinterpret_cast<loop_filter *>(obs_properties_get_param(props));
@@ -311,19 +4491,29 @@ static obs_properties_t *loop_filter_properties(void *data)
 			double actual_duration = base_duration / lf->playback_speed;
 			char duration_text[256];
 			snprintf(duration_text, sizeof(duration_text),
-				 "⏱️ Playback Duration: %.1f seconds at %.1fx speed", actual_duration,
+				 "⏱️ Playback Duration: %.1f seconds at %.2fx speed", actual_duration,
 				 lf->playback_speed);
 			obs_property_set_description(obs_properties_get(props, "duration_info"), duration_text);
 		}
 		return true;
 	});
 
+	// Smooths slow motion and low capture rates by blending neighbouring frames
+	auto *interp_prop = obs_properties_add_list(props, "interpolation", "Frame Interpolation", OBS_COMBO_TYPE_LIST,
+						    OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(interp_prop, "Off (repeat frames)", INTERP_NONE);
+	obs_property_list_add_int(interp_prop, "Blend Neighbouring Frames", INTERP_BLEND);
+	obs_property_list_add_int(interp_prop, "Motion-Compensated (less ghosting, more GPU)", INTERP_FLOW);
+
+	// Filters with the same group name play their loops in step
+	obs_properties_add_text(props, "sync_group", "Sync Group (optional)", OBS_TEXT_DEFAULT);
+
 	// Add playback duration info as separate text field
 	if (lf) {
 		double base_duration = lf->ping_pong ? (lf->buffer_seconds * 2.0) : lf->buffer_seconds;
 		double actual_duration = base_duration / lf->playback_speed;
 		char duration_text[256];
-		snprintf(duration_text, sizeof(duration_text), "⏱️ Playback Duration: %.1f seconds at %.1fx speed",
+		snprintf(duration_text, sizeof(duration_text), "⏱️ Playback Duration: %.1f seconds at %.2fx speed",
 			 actual_duration, lf->playback_speed);
 		obs_properties_add_text(props, "duration_info", duration_text, OBS_TEXT_INFO);
 	}
@@ -332,9 +4522,9 @@ static obs_properties_t *loop_filter_properties(void *data)
 	// (auto-updates interfere with slider dragging)
 	if (lf) {
 		std::lock_guard<std::mutex> lk(lf->frames_mtx);
-		size_t frame_count = lf->frames.size();
-		double content_seconds = frame_count * lf->capture_skip_frames / lf->fps;
-		char status_text[256];
+		size_t frame_count = lf->frame_count;
+		double content_seconds = buffered_seconds_locked(lf);
+		char status_text[512];
 
 		if (lf->loop_enabled) {
 			snprintf(status_text, sizeof(status_text),
@@ -356,12 +4546,35 @@ static obs_properties_t *loop_filter_properties(void *data)
 				 "⏸️ READY: Buffer empty - video will be captured when playing");
 		}
 
+		if (!lf->async_mode) {
+			size_t len = strlen(status_text);
+			snprintf(status_text + len, sizeof(status_text) - len, " | VRAM: %zu/%zuMB",
+				 lf->owned_vram_bytes / (1024 * 1024), lf->max_memory_mb);
+		}
+
+		// Compression results help size the RAM limit for the content being looped
+		if (overflow_is_coded(lf->host_kind)) {
+			codec_stats stats;
+			{
+				std::lock_guard<std::mutex> codec_lk(lf->codec.mtx);
+				stats = lf->codec.stats;
+			}
+			if (stats.encoded > 0) {
+				char codec_text[128];
+				format_codec_stats(stats, codec_text, sizeof(codec_text));
+				size_t len = strlen(status_text);
+				snprintf(status_text + len, sizeof(status_text) - len, " | RAM tier: %zuMB, %s",
+					 lf->host_bytes / (1024 * 1024), codec_text);
+			}
+		}
+
 		auto *status_prop = obs_properties_add_text(props, "buffer_status", "Buffer Status", OBS_TEXT_INFO);
 		obs_property_set_description(status_prop, status_text);
 	}
 
 	// A button to toggle loop state from UI
-	const char *button_text = lf && lf->loop_enabled ? "Stop Loop ⏹" : "Start Loop ▶";
+	const char *button_text = lf && lf->loop_enabled ? (lf->exit_pending ? "Stop Loop Now ⏹" : "Stop Loop ⏹")
+							 : "Start Loop ▶";
 	obs_properties_add_button(
 		props, "toggle_loop", button_text, [](obs_properties_t *, obs_property_t *prop, void *data) -> bool {
 			auto *lf = reinterpret_cast<loop_filter *>(data);
@@ -371,27 +4584,29 @@ static obs_properties_t *loop_filter_properties(void *data)
 			lf->loop_enabled = !lf->loop_enabled;
 
 			std::lock_guard<std::mutex> lk(lf->frames_mtx);
-			size_t frame_count = lf->frames.size();
+			size_t frame_count = lf->frame_count;
 
 			if (lf->loop_enabled) {
 				if (frame_count > 0) {
-					lf->play_index = frame_count - 1;
-					lf->direction = -1;
-					lf->frame_accum = 0.0;
-					lf->total_loops = 0;
-					double content_seconds = frame_count * lf->capture_skip_frames / lf->fps;
+					start_playback_locked(lf);
+					double content_seconds = buffered_seconds_locked(lf);
 					double playback_seconds = content_seconds / lf->playback_speed;
 					if (lf->ping_pong)
 						playback_seconds *= 2.0;
 					blog(LOG_INFO,
 					     "[" PLUGIN_ID
-					     "] Loop STARTED: %zu frames = %.1f seconds content, playback at %.1fx = ~%.1f seconds",
+					     "] Loop STARTED: %zu frames = %.1f seconds content, playback at %.2fx = ~%.1f seconds",
 					     frame_count, content_seconds, lf->playback_speed, playback_seconds);
+					log_buffer_content_locked(lf);
 					obs_property_set_description(prop, "Stop Loop ⏹");
 				} else {
 					blog(LOG_WARNING, "[" PLUGIN_ID "] No frames buffered yet!");
 					lf->loop_enabled = false;
 				}
+			} else if (defer_loop_exit_locked(lf)) {
+				lf->loop_enabled = true;
+				blog(LOG_INFO, "[" PLUGIN_ID "] Loop stopping on the next frame that matches live");
+				obs_property_set_description(prop, "Stop Loop Now ⏹");
 			} else {
 				blog(LOG_INFO, "[" PLUGIN_ID "] Loop STOPPED after %d complete cycles",
 				     lf->total_loops / 2);
@@ -423,14 +4638,14 @@ static obs_properties_t *loop_filter_properties(void *data)
 			obs_enter_graphics();
 			{
 				std::lock_guard<std::mutex> lk(lf->frames_mtx);
-				frame_count = lf->frames.size();
+				frame_count = lf->frame_count;
 				if (frame_count > 0) {
 					clear_frames_locked(lf);
 					// Reset capture tracking
 					lf->capture_start_time = 0;
 					lf->frames_captured_count = 0;
 					lf->last_logged_frame_count = 0;
-					lf->last_capture_time = 0;
+					lf->next_capture_time = 0;
 				}
 			}
 			obs_leave_graphics();
@@ -450,7 +4665,20 @@ static void loop_filter_get_defaults(obs_data_t *settings)
 {
 	obs_data_set_default_int(settings, "buffer_seconds", 30);
 	obs_data_set_default_bool(settings, "ping_pong", true);
+	obs_data_set_default_bool(settings, "seamless_loop", false);
+	obs_data_set_default_bool(settings, "exit_on_match", false);
+	obs_data_set_default_int(settings, "crossfade_frames", 0);
+	obs_data_set_default_double(settings, "ease_seconds", 0.0);
 	obs_data_set_default_double(settings, "playback_speed", 1.0);
+	obs_data_set_default_string(settings, "sync_group", "");
+	obs_data_set_default_int(settings, "storage_format", STORAGE_RGBA);
+	obs_data_set_default_int(settings, "overflow_tier", OVERFLOW_NONE);
+	obs_data_set_default_int(settings, "max_ram_mb", 8192);
+	obs_data_set_default_int(settings, "max_disk_mb", 65536);
+	obs_data_set_default_bool(settings, "async_capture", true);
+	obs_data_set_default_int(settings, "vram_priority", PRIORITY_NORMAL);
+	obs_data_set_default_int(settings, "eviction_policy", EVICT_OLDEST);
+	obs_data_set_default_int(settings, "interpolation", INTERP_NONE);
 }
 
 static void loop_filter_tick(void *data, float seconds)
@@ -470,7 +4698,7 @@ static void loop_filter_tick(void *data, float seconds)
 			lf->last_ui_update = 0.0;
 			// Update properties if we're actively recording or just filled
 			std::lock_guard<std::mutex> lk(lf->frames_mtx);
-			size_t frame_count = lf->frames.size();
+			size_t frame_count = lf->frame_count;
 			if (frame_count > 0) {
 				// Always update when buffer just filled
 				bool just_filled =
@@ -487,6 +4715,57 @@ static void loop_filter_tick(void *data, float seconds)
 		}
 	}
 
+	// Async parents are buffered as raw frames; switching modes starts over
+	obs_source_t *parent = obs_filter_get_parent(lf->context);
+	lf->parent_async = parent &&
+			   (obs_source_get_output_flags(parent) & OBS_SOURCE_ASYNC_VIDEO) == OBS_SOURCE_ASYNC_VIDEO;
+	bool async_mode = lf->async_capture && lf->parent_async;
+	if (async_mode != lf->async_mode) {
+		blog(LOG_INFO, "[" PLUGIN_ID "] %s", async_mode ? "Buffering the async source's frames directly"
+								 : "Buffering rendered frames");
+		obs_enter_graphics();
+		{
+			std::lock_guard<std::mutex> lk(lf->frames_mtx);
+			if (lf->frame_count > 0) {
+				clear_frames_locked(lf);
+				lf->capture_start_time = 0;
+				lf->frames_captured_count = 0;
+				lf->last_logged_frame_count = 0;
+			}
+		}
+		obs_leave_graphics();
+		if (lf->loop_enabled) {
+			lf->loop_enabled = false;
+			obs_source_update_properties(lf->context);
+		}
+		lf->async_mode = async_mode;
+		recalc_buffer(lf);
+	}
+
+	// Measure what this filter holds about once a second, then let the module
+	// re-measure the GPU's free memory when due
+	lf->vram_check_elapsed += seconds;
+	if (lf->vram_check_elapsed >= 1.0f) {
+		lf->vram_check_elapsed = 0.0f;
+		obs_enter_graphics();
+		{
+			std::lock_guard<std::mutex> lk(lf->frames_mtx);
+			lf->owned_vram_bytes = owned_vram_bytes_locked(lf);
+		}
+		uint64_t now = os_gettime_ns();
+		pool_trim(now > LOOPER_POOL_IDLE_NS ? now - LOOPER_POOL_IDLE_NS : 0);
+		obs_leave_graphics();
+		budget_measure();
+	}
+
+	// Apply a new VRAM share after other filters rebalanced. A looping filter
+	// keeps its frames until the loop stops: a smaller share would drop frames,
+	// and a larger one too, since frames spilled to the host tier are never
+	// moved back into VRAM. Either change waits for the loop to end.
+	size_t share_mb = lf->budget_mb;
+	if (lf->shown && share_mb != lf->max_memory_mb && !lf->loop_enabled)
+		recalc_buffer(lf);
+
 	// Update dimensions
 	uint32_t w = obs_source_get_base_width(lf->context);
 	uint32_t h = obs_source_get_base_height(lf->context);
@@ -499,9 +4778,9 @@ static void loop_filter_tick(void *data, float seconds)
 			obs_enter_graphics();
 			{
 				std::lock_guard<std::mutex> lk(lf->frames_mtx);
-				if (lf->frames.size() > 0) {
+				if (lf->frame_count > 0) {
 					blog(LOG_INFO, "[" PLUGIN_ID "] Clearing %zu frames due to resolution change",
-					     lf->frames.size());
+					     lf->frame_count);
 					clear_frames_locked(lf);
 					lf->capture_start_time = 0;
 					lf->frames_captured_count = 0;
@@ -533,78 +4812,17 @@ static void loop_filter_tick(void *data, float seconds)
 		return;
 	}
 
-	// Advance playback cursor based on playback_speed
-	// Our buffer contains frames that represent content at the capture rate
-	// We want to play them back at a rate that stretches them to the original duration
-	// 300 frames over 10 seconds = 30 fps playback rate at 1x speed
-	double frames_per_second = (lf->frames.size() / (double)lf->buffer_seconds) * lf->playback_speed;
-	double step = seconds * frames_per_second;
-	lf->frame_accum += step;
-
-	// Prevent overflow - reset accumulator if it gets too large
-	if (lf->frame_accum > 1000000.0) {
-		blog(LOG_WARNING, "[" PLUGIN_ID "] Frame accumulator overflow protection triggered");
-		lf->frame_accum = 0.0;
-	}
-
-	size_t frames_to_advance = (size_t)lf->frame_accum;
-	lf->frame_accum -= (double)frames_to_advance;
-
-	if (frames_to_advance == 0)
+	// Advance the playback cursor along the frames' capture times, so playback
+	// runs at playback_speed times real speed whatever the fill level, capture
+	// jitter or skipped captures
+	std::lock_guard<std::mutex> lk(lf->frames_mtx);
+	sync_apply_setting_locked(lf);
+	if (lf->frame_count < 2)
 		return;
+	advance_playback_locked(lf, seconds);
 
-	std::lock_guard<std::mutex> lk(lf->frames_mtx);
-	if (lf->frames.size() < 2)
-		return;
-
-	for (size_t i = 0; i < frames_to_advance; ++i) {
-		// Move the index
-		if (lf->direction > 0) {
-			if (lf->play_index + 1 >= lf->frames.size()) {
-				if (lf->ping_pong) {
-					lf->direction = -1;
-					if (lf->play_index > 0)
-						lf->play_index--;
-					lf->total_loops++;
-					// Prevent overflow of loop counter
-					if (lf->total_loops > 1000000) {
-						lf->total_loops = 0;
-					}
-				} else {
-					lf->play_index = 0;
-					lf->total_loops++;
-					// Prevent overflow of loop counter
-					if (lf->total_loops > 1000000) {
-						lf->total_loops = 0;
-					}
-				}
-			} else {
-				lf->play_index++;
-			}
-		} else {
-			if (lf->play_index == 0) {
-				if (lf->ping_pong) {
-					lf->direction = +1;
-					if (lf->frames.size() > 1)
-						lf->play_index++;
-					lf->total_loops++;
-					// Prevent overflow of loop counter
-					if (lf->total_loops > 1000000) {
-						lf->total_loops = 0;
-					}
-				} else {
-					lf->play_index = lf->frames.size() - 1;
-					lf->total_loops++;
-					// Prevent overflow of loop counter
-					if (lf->total_loops > 1000000) {
-						lf->total_loops = 0;
-					}
-				}
-			} else {
-				lf->play_index--;
-			}
-		}
-	}
+	// Disk and compressed frames take time to read back, so stay ahead of the cursor
+	prefetch_host_frames_locked(lf);
 }
 
 static void loop_filter_render(void *data, gs_effect_t *effect)
@@ -628,162 +4846,206 @@ static void loop_filter_render(void *data, gs_effect_t *effect)
 	lf->base_h = h;
 	lf->dimensions_valid = true;
 
+	// Async frames are buffered and replayed in loop_filter_video() before the
+	// source draws them, so rendering is always a passthrough
+	if (lf->async_mode) {
+		obs_source_skip_video_filter(lf->context);
+		return;
+	}
+
 	// If loop is enabled and we have frames, play from buffer
 	if (lf->loop_enabled) {
+		profile_start(playback_profile_name);
+		gpu_timer_scope gpu_time(&lf->playback_gpu);
+
 		// Keep mutex locked while accessing frame to prevent race condition
 		std::lock_guard<std::mutex> lk(lf->frames_mtx);
 
-		if (!lf->frames.empty() && lf->play_index < lf->frames.size()) {
-			gs_texrender_t *frame_to_draw = lf->frames[lf->play_index];
-
-			if (frame_to_draw) {
-				gs_texture_t *tex = gs_texrender_get_texture(frame_to_draw);
-				if (tex) {
-					// Use obs_source_draw to render the buffered frame
-					gs_effect_t *default_effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
-					gs_eparam_t *image = gs_effect_get_param_by_name(default_effect, "image");
-					gs_effect_set_texture(image, tex);
+		// Frames still being read back become available before playback starts
+		if (lf->readback.count > 0)
+			flush_readbacks_locked(lf);
+		if (lf->probes.count > 0)
+			flush_probes_locked(lf);
+		collect_encoded_locked(lf);
+
+		// A stop waiting for a match keeps playing until the frame on screen
+		// looks like live, which this frame already may
+		if (lf->exit_pending) {
+			probe_live_locked(lf, w, h);
+			if (check_loop_exit_locked(lf)) {
+				profile_end(playback_profile_name);
+				obs_source_skip_video_filter(lf->context);
+				return;
+			}
+		}
 
-					while (gs_effect_loop(default_effect, "Draw")) {
-						gs_draw_sprite(tex, 0, w, h);
-					}
-					return;
-				}
+		if (lf->frame_count > 0 && lf->play_index < lf->frame_count) {
+			gs_texture_t *tex = frame_texture_locked(lf, lf->play_index, false);
+			gs_texture_t *next = nullptr;
+			if (tex && lf->blend_index != SIZE_MAX && lf->blend_weight > 0.0f)
+				next = frame_texture_locked(lf, lf->blend_index, true);
+			// Motion search pays off where frames stay on screen for a while: up
+			// to 1x and around ping-pong turns. Faster playback blends.
+			bool turning = lf->ping_pong && (lf->play_index == 0 || lf->blend_index + 1 == lf->frame_count);
+			gs_texture_t *motion = nullptr;
+			if (tex && next && lf->interpolation == INTERP_FLOW && !lf->crossfading &&
+			    (lf->playback_speed <= 1.0 || turning))
+				motion = flow_field_locked(lf, lf->play_index, tex, lf->blend_index, next, w, h);
+			if (motion) {
+				draw_flow_frames(lf, tex, next, motion, lf->blend_weight, w, h);
+				profile_end(playback_profile_name);
+				return;
+			}
+			if (tex && next) {
+				draw_blended_frames(lf, tex, next, lf->blend_weight, w, h);
+				profile_end(playback_profile_name);
+				return;
+			}
+			if (tex) {
+				draw_stored_frame(lf, tex, w, h);
+				profile_end(playback_profile_name);
+				return;
 			}
 		}
+		profile_end(playback_profile_name);
+
 		// If no valid frame, skip the filter
 		obs_source_skip_video_filter(lf->context);
 		return;
 	}
 
-	// Default: capture source to buffer if not looping
-	// First, we need to capture the current frame
-	gs_texrender_t *texrender = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
-
-	if (!texrender) {
-		blog(LOG_ERROR, "[" PLUGIN_ID "] Failed to create texrender for capture");
+	// Default: capture source to buffer if not looping.
+	// Decide whether this frame is a capture before doing any offscreen work, so
+	// frames between captures are a plain passthrough. Async parents are only
+	// captured when they delivered a new frame; other sources once per due canvas
+	// frame, which also skips repeat renders of the same canvas frame in other views.
+	bool due;
+	uint64_t capture_time;
+	{
+		std::lock_guard<std::mutex> lk(lf->frames_mtx);
+		capture_time = lf->parent_async ? lf->source_frame_time : obs_get_video_frame_time();
+		due = (!lf->parent_async || lf->source_frame_pending) && capture_due_locked(lf, capture_time);
+	}
+	if (!due) {
 		obs_source_skip_video_filter(lf->context);
 		return;
 	}
+	uint64_t current_time = os_gettime_ns();
 
-	// Use RAII-style cleanup to ensure texrender is always destroyed
-	bool render_success = false;
+	// The parent is rendered exactly once (straight into the ring's spare slot
+	// for RGBA storage) and that full-quality texture is the output for this frame.
+	profile_start(capture_profile_name);
+	gpu_timer_scope gpu_time(&lf->capture_gpu);
 
-	if (gs_texrender_begin(texrender, w, h)) {
-		vec4 clear_color = {0.0f, 0.0f, 0.0f, 0.0f};
-		gs_clear(GS_CLEAR_COLOR, &clear_color, 1.0f, 0);
-
-		// Render parent source
-		obs_source_t *parent = obs_filter_get_parent(lf->context);
-		if (parent) {
-			obs_source_video_render(parent);
-		}
+	std::lock_guard<std::mutex> lk(lf->frames_mtx);
+	collect_encoded_locked(lf);
 
-		gs_texrender_end(texrender);
-		render_success = true;
+	gs_texrender_t *slot = ring_next_slot_locked(lf);
+	gs_texture_t *output = slot ? capture_frame_locked(lf, slot, w, h) : nullptr;
+	if (!output) {
+		profile_end(capture_profile_name);
+		obs_source_skip_video_filter(lf->context);
+		return;
 	}
 
-	if (render_success) {
-
-		// Capture frame to buffer based on time intervals to ensure correct timing
-		uint64_t current_time = os_gettime_ns();
+	schedule_capture_locked(lf, capture_time);
+	lf->source_frame_pending = false;
 
-		// Calculate minimum time between captures based on desired frame rate
-		// We want to capture at effective_fps = fps / capture_skip_frames
-		uint64_t min_capture_interval = (uint64_t)(1000000000.0 * lf->capture_skip_frames / lf->fps);
-
-		// Check if enough time has passed since last capture
-		if (current_time - lf->last_capture_time >= min_capture_interval) {
-			lf->last_capture_time = current_time;
+	// Track capture start
+	if (lf->frame_count == 0 && lf->capture_start_time == 0) {
+		lf->capture_start_time = current_time;
+		lf->frames_captured_count = 0;
+		blog(LOG_INFO, "[" PLUGIN_ID "] Starting buffer capture at fps=%.2f, target capture rate=%.2f fps",
+		     lf->fps, lf->fps / lf->capture_skip_frames);
+	}
 
-			// Only capture if not looping
-			std::lock_guard<std::mutex> lk(lf->frames_mtx);
-			if (!lf->loop_enabled) {
+	// Keep the slot, replacing the oldest frame once full, and measure it for the metadata
+	uint64_t serial = ring_commit_locked(lf, capture_time);
+	probe_capture_locked(lf, output, serial);
+	lf->frames_captured_count++;
+
+	// Log periodically and when buffer fills
+	static int log_counter = 0;
+	bool should_log = (++log_counter % 30 == 0) || (lf->frame_count == lf->max_frames);
+
+	if (should_log && lf->capture_start_time > 0) {
+		double elapsed = (current_time - lf->capture_start_time) / 1000000000.0;
+		double buffer_seconds = buffered_seconds_locked(lf);
+		double capture_rate = lf->frames_captured_count / elapsed;
+		blog(LOG_INFO,
+		     "[" PLUGIN_ID
+		     "] Buffer: %zu/%zu frames (%.1f/%.1f sec content) | Elapsed: %.1fs | Capture rate: %.1f fps",
+		     lf->frame_count, lf->max_frames, buffer_seconds, (double)lf->buffer_seconds, elapsed,
+		     capture_rate);
+
+		if (lf->frame_count == lf->max_frames) {
+			blog(LOG_INFO, "[" PLUGIN_ID "] Buffer FILLED in %.1f seconds (expected ~%d seconds) - Timing %s",
+			     elapsed, lf->buffer_seconds, (elapsed < lf->buffer_seconds * 0.9) ? "TOO FAST!" : "OK");
+		}
+	}
 
-				// Track capture start
-				if (lf->frames.empty() && lf->capture_start_time == 0) {
-					lf->capture_start_time = current_time;
-					lf->frames_captured_count = 0;
-					blog(LOG_INFO,
-					     "[" PLUGIN_ID
-					     "] Starting buffer capture at fps=%.2f, target capture rate=%.2f fps",
-					     lf->fps, lf->fps / lf->capture_skip_frames);
-				}
+	// Draw the captured frame as output instead of rendering the parent again
+	draw_frame_texture(output, w, h);
 
-				// Create new texrender for this frame
-				gs_texrender_t *frame_copy = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
-				if (!frame_copy) {
-					blog(LOG_ERROR, "[" PLUGIN_ID "] Failed to create frame copy texrender");
-				} else if (gs_texrender_begin(frame_copy, w, h)) {
-					vec4 clear = {0.0f, 0.0f, 0.0f, 0.0f};
-					gs_clear(GS_CLEAR_COLOR, &clear, 1.0f, 0);
-
-					// Copy the texture
-					gs_texture_t *src_tex = gs_texrender_get_texture(texrender);
-					if (src_tex) {
-						gs_effect_t *copy_effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
-						gs_eparam_t *image = gs_effect_get_param_by_name(copy_effect, "image");
-						gs_effect_set_texture(image, src_tex);
-
-						while (gs_effect_loop(copy_effect, "Draw")) {
-							gs_draw_sprite(src_tex, 0, w, h);
-						}
-					}
+	profile_end(capture_profile_name);
+}
 
-					gs_texrender_end(frame_copy);
+// Async sources: runs on every new frame from the source before it is uploaded.
+// Recording keeps a copy; looping copies a buffered frame into the incoming one.
+static struct obs_source_frame *loop_filter_video(void *data, struct obs_source_frame *frame)
+{
+	auto *lf = reinterpret_cast<loop_filter *>(data);
+	if (!lf || !frame)
+		return frame;
 
-					// Add to buffer
-					lf->frames.push_back(frame_copy);
-					lf->frames_captured_count++;
+	std::lock_guard<std::mutex> lk(lf->frames_mtx);
 
-					if (lf->frames.size() > lf->max_frames) {
-						auto *oldest = lf->frames.front();
-						lf->frames.pop_front();
-						if (oldest)
-							gs_texrender_destroy(oldest);
-					}
+	// Rendered capture of an async parent waits for frames announced here
+	if (!lf->async_mode) {
+		lf->source_frame_pending = true;
+		lf->source_frame_time = frame->timestamp;
+		return frame;
+	}
 
-					// Log periodically and when buffer fills
-					if (!lf->loop_enabled) {
-						static int log_counter = 0;
-						bool should_log = (++log_counter % 30 == 0) ||
-								  (lf->frames.size() == lf->max_frames);
-
-						if (should_log && lf->capture_start_time > 0) {
-							double elapsed =
-								(current_time - lf->capture_start_time) / 1000000000.0;
-							double buffer_seconds =
-								lf->frames.size() * lf->capture_skip_frames / lf->fps;
-							double capture_rate = lf->frames_captured_count / elapsed;
-							blog(LOG_INFO,
-							     "[" PLUGIN_ID
-							     "] Buffer: %zu/%zu frames (%.1f/%.1f sec content) | Elapsed: %.1fs | Capture rate: %.1f fps",
-							     lf->frames.size(), lf->max_frames, buffer_seconds,
-							     (double)lf->buffer_seconds, elapsed, capture_rate);
-
-							if (lf->frames.size() == lf->max_frames) {
-								blog(LOG_INFO,
-								     "[" PLUGIN_ID
-								     "] Buffer FILLED in %.1f seconds (expected ~%d seconds) - Timing %s",
-								     elapsed, lf->buffer_seconds,
-								     (elapsed < lf->buffer_seconds * 0.9) ? "TOO FAST!"
-													  : "OK");
-								// Reset for next capture but don't clear start time for continued logging
-							}
-						}
-					}
-				} else if (frame_copy) {
-					gs_texrender_destroy(frame_copy);
-				}
-			}
+	if (lf->loop_enabled) {
+		if (lf->exit_pending) {
+			lf->live_thumb_valid = async_luma_thumb(frame, lf->live_thumb);
+			if (check_loop_exit_locked(lf))
+				return frame;
 		}
+		if (lf->play_index >= lf->async_frames.count)
+			return frame;
+
+		// libobs sized the source's textures for the incoming frame, so only a
+		// buffered frame of the same format and size can replace it
+		obs_source_frame *stored = lf->async_frames.at(lf->play_index);
+		if (!stored || stored->format != frame->format || stored->width != frame->width ||
+		    stored->height != frame->height)
+			return frame;
+
+		// libobs uploads and releases the returned frame after the lock is gone,
+		// and the ring may free its slots meanwhile, so hand back the source's own
+		// frame with the buffered picture copied in, on the source's live clock
+		uint64_t timestamp = frame->timestamp;
+		obs_source_frame_copy(frame, stored);
+		frame->timestamp = timestamp;
+		return frame;
 	}
 
-	// Always cleanup texrender
-	gs_texrender_destroy(texrender);
+	if (!capture_due_locked(lf, frame->timestamp))
+		return frame;
+	schedule_capture_locked(lf, frame->timestamp);
+
+	if (lf->frame_count == 0 && lf->capture_start_time == 0) {
+		lf->capture_start_time = os_gettime_ns();
+		lf->frames_captured_count = 0;
+		blog(LOG_INFO, "[" PLUGIN_ID "] Starting async buffer capture: %ux%u, format %d, target %.2f fps",
+		     frame->width, frame->height, (int)frame->format, lf->fps / lf->capture_skip_frames);
+	}
 
-	// Pass through the source video
-	obs_source_skip_video_filter(lf->context);
+	async_commit_locked(lf, frame);
+	lf->frames_captured_count++;
+	return frame;
 }
 
 static void loop_filter_show(void *data)
@@ -794,17 +5056,23 @@ static void loop_filter_show(void *data)
 
 	blog(LOG_INFO, "[" PLUGIN_ID "] Filter shown - clearing buffer to start fresh");
 
+	// Reclaim a VRAM share; a changed share is applied on the next tick
+	lf->shown = true;
+	budget_set_shown(lf, true);
+
 	// Clear buffer when filter is shown to avoid stale content
 	obs_enter_graphics();
 	{
 		std::lock_guard<std::mutex> lk(lf->frames_mtx);
-		if (lf->frames.size() > 0) {
+		// Ring was released on hide
+		resize_ring_locked(lf);
+		if (lf->frame_count > 0) {
 			clear_frames_locked(lf);
 			// Reset all capture tracking
 			lf->capture_start_time = 0;
 			lf->frames_captured_count = 0;
 			lf->last_logged_frame_count = 0;
-			lf->last_capture_time = 0;
+			lf->next_capture_time = 0;
 		}
 	}
 	obs_leave_graphics();
@@ -830,22 +5098,26 @@ static void loop_filter_hide(void *data)
 		// Properties will update on next refresh
 	}
 
-	// Clear buffer when filter is hidden
+	// Clear buffer when filter is hidden and give its VRAM back until shown again
 	obs_enter_graphics();
 	{
 		std::lock_guard<std::mutex> lk(lf->frames_mtx);
-		if (lf->frames.size() > 0) {
-			size_t frame_count = lf->frames.size();
+		if (lf->frame_count > 0) {
+			size_t frame_count = lf->frame_count;
 			clear_frames_locked(lf);
 			blog(LOG_INFO, "[" PLUGIN_ID "] Cleared %zu frames on hide", frame_count);
 			// Reset all capture tracking
 			lf->capture_start_time = 0;
 			lf->frames_captured_count = 0;
 			lf->last_logged_frame_count = 0;
-			lf->last_capture_time = 0;
+			lf->next_capture_time = 0;
 		}
+		destroy_ring_locked(lf);
 	}
 	obs_leave_graphics();
+
+	lf->shown = false;
+	budget_set_shown(lf, false);
 }
 
 // ----------------------------- Hotkeys -----------------------------
@@ -861,28 +5133,30 @@ static void loop_filter_toggle_cb(void *data, obs_hotkey_id, obs_hotkey_t *, boo
 	lf->loop_enabled = !lf->loop_enabled;
 
 	std::lock_guard<std::mutex> lk(lf->frames_mtx);
-	size_t frame_count = lf->frames.size();
+	size_t frame_count = lf->frame_count;
 
 	if (lf->loop_enabled) {
 		if (frame_count > 0) {
-			lf->play_index = frame_count - 1;
-			lf->direction = -1;
-			lf->frame_accum = 0.0;
-			lf->total_loops = 0;
-			double content_seconds = frame_count * lf->capture_skip_frames / lf->fps;
+			start_playback_locked(lf);
+			double content_seconds = buffered_seconds_locked(lf);
 			double playback_seconds = content_seconds / lf->playback_speed;
 			if (lf->ping_pong)
 				playback_seconds *= 2.0;
 			blog(LOG_INFO,
 			     "[" PLUGIN_ID
-			     "] Hotkey: Loop STARTED - %zu frames = %.1f seconds content, playback at %.1fx = ~%.1f seconds",
+			     "] Hotkey: Loop STARTED - %zu frames = %.1f seconds content, playback at %.2fx = ~%.1f seconds",
 			     frame_count, content_seconds, lf->playback_speed, playback_seconds);
+			log_buffer_content_locked(lf);
 			// Properties will update on next refresh
 			obs_source_update_properties(lf->context);
 		} else {
 			blog(LOG_WARNING, "[" PLUGIN_ID "] No frames in buffer!");
 			lf->loop_enabled = false;
 		}
+	} else if (defer_loop_exit_locked(lf)) {
+		lf->loop_enabled = true;
+		blog(LOG_INFO, "[" PLUGIN_ID "] Hotkey: Loop stopping on the next frame that matches live");
+		obs_source_update_properties(lf->context);
 	} else {
 		blog(LOG_INFO, "[" PLUGIN_ID "] Hotkey: Loop STOPPED after %d complete cycles", lf->total_loops / 2);
 		// Properties will update on next refresh
@@ -902,6 +5176,21 @@ bool obs_module_load(void)
 {
 	blog(LOG_INFO, "[" PLUGIN_ID "] Loading module...");
 
+	{
+		std::lock_guard<std::mutex> lk(module_budget.mtx);
+		module_budget.total_mb = LOOPER_VRAM_BUDGET_MB;
+		module_budget.measured = false;
+		module_budget.query_failed = false;
+		module_budget.last_measure = 0;
+		module_budget.entries.clear();
+	}
+	{
+		std::lock_guard<std::mutex> lk(module_sync.mtx);
+		module_sync.groups.clear();
+	}
+	blog(LOG_INFO, "[" PLUGIN_ID "] VRAM budget of %dMB shared by all Looper filters until GPU memory is measured",
+	     LOOPER_VRAM_BUDGET_MB);
+
 	obs_source_info loop_filter_info = {};
 
 	loop_filter_info.id = PLUGIN_ID;
@@ -917,11 +5206,29 @@ bool obs_module_load(void)
 
 	loop_filter_info.video_render = loop_filter_render;
 	loop_filter_info.video_tick = loop_filter_tick;
+	loop_filter_info.filter_video = loop_filter_video;
 	loop_filter_info.show = loop_filter_show;
 	loop_filter_info.hide = loop_filter_hide;
 
 	obs_register_source(&loop_filter_info);
 
+#ifdef LOOPER_ENCODED_RING
+	obs_output_info h264_sink_info = {};
+
+	h264_sink_info.id = LOOPER_H264_OUTPUT_ID;
+	h264_sink_info.flags = OBS_OUTPUT_VIDEO | OBS_OUTPUT_ENCODED;
+	h264_sink_info.encoded_video_codecs = "h264";
+
+	h264_sink_info.get_name = h264_sink_get_name;
+	h264_sink_info.create = h264_sink_create;
+	h264_sink_info.destroy = h264_sink_destroy;
+	h264_sink_info.start = h264_sink_start;
+	h264_sink_info.stop = h264_sink_stop;
+	h264_sink_info.encoded_packet = h264_sink_packet;
+
+	obs_register_output(&h264_sink_info);
+#endif
+
 	blog(LOG_INFO, "[" PLUGIN_ID "] Module loaded successfully");
 	return true;
 }